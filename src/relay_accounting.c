@@ -0,0 +1,405 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_accounting.c
+ * @brief Accumulates relay on-time and switch cycles from monotonic timestamps of state changes.
+ *        Counters are persisted at most once per flush interval, each write going to next of
+ *        RELAY_ACCOUNTING_NUM_SLOTS slots of persistence file, so flash wear does not depend on
+ *        how often relay toggles and an interrupted write never loses previous counters. Counters
+ *        have their own lock, which is never held during file I/O, so relay control (including
+ *        connection loss failover) never waits for flash.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "relay_accounting.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define RECORD_MAGIC                (0x52474143u)   /* "RGAC" */
+//! @endcond
+
+/***************************************************************************************************
+ * Typedef
+ **************************************************************************************************/
+
+/**
+ * Persisted counters of single instance.
+ */
+typedef struct
+{
+    /*@{*/
+    uint64_t onTimeMs; /**< cumulative on-time in milliseconds */
+    uint64_t cycles; /**< number of off to on transitions */
+    /*@}*/
+} InstanceCounters;
+
+/**
+ * Single slot of persistence file.
+ */
+typedef struct
+{
+    /*@{*/
+    uint32_t magic; /**< RECORD_MAGIC */
+    uint32_t sequence; /**< write sequence, slot with highest valid sequence is current */
+    uint32_t numInstances; /**< number of valid entries in counters */
+    uint32_t reserved; /**< padding, always 0 */
+    InstanceCounters counters[RELAY_ACCOUNTING_MAX_INSTANCES]; /**< per instance counters */
+    uint32_t crc; /**< CRC32 of all preceding fields */
+    uint32_t reserved2; /**< padding, always 0 */
+    /*@}*/
+} Record;
+
+/**
+ * Runtime accounting state of single instance.
+ */
+typedef struct
+{
+    /*@{*/
+    bool known; /**< whether initial state was noted */
+    bool state; /**< last noted state */
+    uint64_t changedMs; /**< monotonic time since which on-time of current period is not in counters */
+    InstanceCounters counters; /**< cumulative counters */
+    /*@}*/
+} InstanceAccounting;
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Accounting state of all instances. */
+static InstanceAccounting g_instances[RELAY_ACCOUNTING_MAX_INSTANCES];
+/** Number of accounted instances. */
+static unsigned int g_numInstances = 0;
+/** Persistence file descriptor, -1 if counters are kept in memory only. */
+static int g_fd = -1;
+/** Sequence of last written slot. */
+static uint32_t g_sequence = 0;
+/** Minimal time between two writes to persistence file. */
+static uint64_t g_flushIntervalMs = 0;
+/** Monotonic time of last write to persistence file. */
+static uint64_t g_lastFlushMs = 0;
+/** Whether counters changed since last write. */
+static bool g_dirty = false;
+/** Protects all of the above except persistence file, which is written by main loop only. */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+static uint64_t MonotonicMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static uint32_t Crc32(const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    size_t i;
+    int bit;
+
+    for (i = 0; i < size; i++)
+    {
+        crc ^= bytes[i];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Moves on-time of current on period into counters.
+ */
+static void FoldOnTime(InstanceAccounting *instance, uint64_t now)
+{
+    if (instance->known && instance->state)
+    {
+        instance->counters.onTimeMs += now - instance->changedMs;
+    }
+    instance->changedMs = now;
+}
+
+/**
+ * @brief Loads counters from newest valid slot of persistence file.
+ */
+static void LoadCounters(void)
+{
+    Record record;
+    bool found = false;
+    unsigned int slot, i;
+
+    for (slot = 0; slot < RELAY_ACCOUNTING_NUM_SLOTS; slot++)
+    {
+        if (pread(g_fd, &record, sizeof(record), slot * sizeof(record)) != sizeof(record))
+        {
+            continue;
+        }
+        if (record.magic != RECORD_MAGIC ||
+            record.numInstances > RELAY_ACCOUNTING_MAX_INSTANCES ||
+            record.crc != Crc32(&record, offsetof(Record, crc)))
+        {
+            continue;
+        }
+        if (found && (int32_t)(record.sequence - g_sequence) <= 0)
+        {
+            continue;
+        }
+        found = true;
+        g_sequence = record.sequence;
+        for (i = 0; i < record.numInstances && i < g_numInstances; i++)
+        {
+            g_instances[i].counters = record.counters[i];
+        }
+    }
+
+    if (found)
+    {
+        LOG(LOG_INFO, "Loaded relay accounting counters, sequence %u", g_sequence);
+    }
+}
+
+/**
+ * @brief Writes counters to next slot of persistence file. Must be called without g_lock held.
+ */
+static void FlushCounters(uint64_t now)
+{
+    Record record;
+    unsigned int i;
+
+    memset(&record, 0, sizeof(record));
+    pthread_mutex_lock(&g_lock);
+    for (i = 0; i < g_numInstances; i++)
+    {
+        FoldOnTime(&g_instances[i], now);
+        record.counters[i] = g_instances[i].counters;
+    }
+    /* Failed write is retried after next flush interval, not on every loop pass. */
+    g_lastFlushMs = now;
+    g_dirty = false;
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_fd == -1)
+    {
+        return;
+    }
+
+    record.magic = RECORD_MAGIC;
+    record.sequence = g_sequence + 1;
+    record.numInstances = g_numInstances;
+    record.crc = Crc32(&record, offsetof(Record, crc));
+
+    if (pwrite(g_fd, &record, sizeof(record),
+            (record.sequence % RELAY_ACCOUNTING_NUM_SLOTS) * sizeof(record)) != sizeof(record) ||
+        fdatasync(g_fd) == -1)
+    {
+        LOG(LOG_WARN, "Failed to persist relay accounting counters.");
+        pthread_mutex_lock(&g_lock);
+        g_dirty = true;
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_sequence = record.sequence;
+}
+
+bool RelayAccounting_Init(const char *filePath, unsigned int numInstances, unsigned int flushInterval)
+{
+    memset(g_instances, 0, sizeof(g_instances));
+    g_numInstances = numInstances < RELAY_ACCOUNTING_MAX_INSTANCES ?
+        numInstances : RELAY_ACCOUNTING_MAX_INSTANCES;
+    g_flushIntervalMs = (uint64_t)flushInterval * 1000;
+    g_lastFlushMs = MonotonicMs();
+    g_dirty = false;
+
+    if (filePath == NULL)
+    {
+        g_fd = -1;
+        return false;
+    }
+
+    g_fd = open(filePath, O_RDWR | O_CREAT, 0644);
+    if (g_fd == -1)
+    {
+        LOG(LOG_WARN, "Failed to open relay accounting file %s, counters won't be persisted.",
+            filePath);
+        return false;
+    }
+    LoadCounters();
+    return true;
+}
+
+void RelayAccounting_NoteState(unsigned int instanceID, bool state)
+{
+    InstanceAccounting *instance;
+    uint64_t now;
+
+    if (instanceID >= g_numInstances)
+    {
+        return;
+    }
+    pthread_mutex_lock(&g_lock);
+    instance = &g_instances[instanceID];
+    if (!instance->known || instance->state != state)
+    {
+        now = MonotonicMs();
+        FoldOnTime(instance, now);
+        if (instance->known && state)
+        {
+            instance->counters.cycles++;
+        }
+        instance->known = true;
+        instance->state = state;
+        g_dirty = true;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+int64_t RelayAccounting_GetOnTime(unsigned int instanceID)
+{
+    InstanceAccounting *instance;
+    uint64_t onTimeMs;
+
+    if (instanceID >= g_numInstances)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&g_lock);
+    instance = &g_instances[instanceID];
+    onTimeMs = instance->counters.onTimeMs;
+    if (instance->known && instance->state)
+    {
+        onTimeMs += MonotonicMs() - instance->changedMs;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return onTimeMs / 1000;
+}
+
+void RelayAccounting_ResetOnTime(unsigned int instanceID)
+{
+    if (instanceID >= g_numInstances)
+    {
+        return;
+    }
+    pthread_mutex_lock(&g_lock);
+    g_instances[instanceID].counters.onTimeMs = 0;
+    g_instances[instanceID].changedMs = MonotonicMs();
+    g_dirty = true;
+    pthread_mutex_unlock(&g_lock);
+}
+
+int64_t RelayAccounting_GetCycles(unsigned int instanceID)
+{
+    int64_t cycles;
+
+    if (instanceID >= g_numInstances)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&g_lock);
+    cycles = g_instances[instanceID].counters.cycles;
+    pthread_mutex_unlock(&g_lock);
+    return cycles;
+}
+
+/**
+ * @brief Returns true if persisted counters are out of date. Must be called with g_lock held.
+ */
+static bool IsDirty(void)
+{
+    unsigned int i;
+
+    /* Relay that stays on keeps accumulating on-time, which has to reach flash as well. */
+    for (i = 0; i < g_numInstances && !g_dirty; i++)
+    {
+        g_dirty = g_instances[i].known && g_instances[i].state;
+    }
+    return g_dirty;
+}
+
+uint64_t RelayAccounting_GetNextFlush(void)
+{
+    uint64_t nextFlush;
+
+    pthread_mutex_lock(&g_lock);
+    nextFlush = IsDirty() ? g_lastFlushMs + g_flushIntervalMs : UINT64_MAX;
+    pthread_mutex_unlock(&g_lock);
+    return nextFlush;
+}
+
+void RelayAccounting_Process(void)
+{
+    uint64_t now = MonotonicMs();
+    bool due;
+
+    pthread_mutex_lock(&g_lock);
+    due = now - g_lastFlushMs >= g_flushIntervalMs && IsDirty();
+    pthread_mutex_unlock(&g_lock);
+    if (due)
+    {
+        FlushCounters(now);
+    }
+}
+
+void RelayAccounting_Deinit(void)
+{
+    bool due;
+
+    pthread_mutex_lock(&g_lock);
+    due = IsDirty();
+    pthread_mutex_unlock(&g_lock);
+    if (due)
+    {
+        FlushCounters(MonotonicMs());
+    }
+    if (g_fd != -1)
+    {
+        close(g_fd);
+        g_fd = -1;
+    }
+}
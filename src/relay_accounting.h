@@ -0,0 +1,97 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_accounting.h
+ * @brief Cumulative relay on-time and switch cycle accounting, persisted with bounded flash wear.
+ */
+
+#ifndef RELAY_ACCOUNTING_H
+#define RELAY_ACCOUNTING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! \{
+#define RELAY_ACCOUNTING_MAX_INSTANCES  (8)
+#define RELAY_ACCOUNTING_NUM_SLOTS      (8)
+//! \}
+
+/**
+ * @brief Loads last persisted counters and prepares accounting.
+ * @param *filePath file holding persisted counters, created if missing. NULL keeps counters in
+ *        memory only.
+ * @param numInstances number of relay instances to account for.
+ * @param flushInterval minimal number of seconds between two writes to file.
+ * @return true if counters can be persisted, false if accounting works in memory only.
+ */
+bool RelayAccounting_Init(const char *filePath, unsigned int numInstances, unsigned int flushInterval);
+
+/**
+ * @brief Accounts relay state of given instance. Must be called with initial state and on every
+ *        state change, calls with unchanged state are ignored.
+ * @param instanceID relay object instance ID.
+ * @param state current relay state.
+ */
+void RelayAccounting_NoteState(unsigned int instanceID, bool state);
+
+/**
+ * @brief Returns cumulative on-time of instance in seconds, including current on period.
+ */
+int64_t RelayAccounting_GetOnTime(unsigned int instanceID);
+
+/**
+ * @brief Resets cumulative on-time of instance.
+ */
+void RelayAccounting_ResetOnTime(unsigned int instanceID);
+
+/**
+ * @brief Returns number of off to on transitions of instance.
+ */
+int64_t RelayAccounting_GetCycles(unsigned int instanceID);
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in milliseconds at which counters are due to be persisted,
+ *        or UINT64_MAX if they are up to date.
+ */
+uint64_t RelayAccounting_GetNextFlush(void);
+
+/**
+ * @brief Persists counters if they changed and flush interval elapsed since last write. Must be
+ *        called from main loop only, other functions are thread safe and never wait for the write.
+ */
+void RelayAccounting_Process(void);
+
+/**
+ * @brief Persists counters if they changed and closes persistence file.
+ */
+void RelayAccounting_Deinit(void);
+
+#endif  /* RELAY_ACCOUNTING_H */
@@ -0,0 +1,319 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_control.c
+ * @brief Handles operations on relay object resources and drives relay click through GPIO sysfs.
+ *        Every handler invocation is passed to trace recorder.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "relay_control.h"
+#include "relay_state_shm.h"
+#include "relay_accounting.h"
+#include "relay_trace.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define GPIO_PATH_SIZE              (128)
+//! @endcond
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+bool g_relayState = false;
+/** Keeps value of last read accounting resource */
+static AwaInteger g_accountingValue = 0;
+/** Keeps directory under which GPIO sysfs files are accessed */
+static const char *g_gpioRoot = DEFAULT_GPIO_ROOT;
+/** Serialises relay output changes of handlers and connection loss timer */
+static pthread_mutex_t g_outputLock = PTHREAD_MUTEX_INITIALIZER;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+void RelayControl_SetGPIORoot(const char *path)
+{
+    g_gpioRoot = path;
+}
+
+void RelayControl_Lock(void)
+{
+    pthread_mutex_lock(&g_outputLock);
+}
+
+void RelayControl_Unlock(void)
+{
+    pthread_mutex_unlock(&g_outputLock);
+}
+
+/**
+ * @brief Drives relay output and notes its new state. Must be called with output lock held.
+ */
+static void ApplyState(unsigned int instanceID, bool state)
+{
+    ChangeRelayState(state);
+    RelayStateShm_Publish(instanceID, state);
+    RelayAccounting_NoteState(instanceID, state);
+}
+
+void RelayControl_ForceState(unsigned int instanceID, bool state)
+{
+    RelayControl_Lock();
+    ApplyState(instanceID, state);
+    RelayControl_Unlock();
+}
+
+void RelayControl_ReassertState(unsigned int instanceID)
+{
+    RelayControl_Lock();
+    ApplyState(instanceID, g_relayState);
+    RelayControl_Unlock();
+}
+
+int ReadGPIO(bool * value, int pin)
+{
+    char path[GPIO_PATH_SIZE];
+    char valueStr[3] = {0};
+    int fd;
+    snprintf(path, GPIO_PATH_SIZE, "%s/gpio%d/value", g_gpioRoot, pin);
+    fd = open(path, O_RDONLY);
+    if (-1 == fd) {
+        LOG(LOG_ERR, "Failed to open gpio value for reading!\n");
+        return(-1);
+    }
+
+    if (-1 == read(fd, valueStr, sizeof(valueStr) - 1)) {
+        LOG(LOG_ERR, "Failed to read value!\n");
+        close(fd);
+        return(-1);
+    }
+    close(fd);
+    *value = (bool)!!atoi(valueStr);
+    return 0;
+}
+
+/**
+ * @brief Writes string to GPIO sysfs attribute of relay pin.
+ * @return true on success, false otherwise.
+ */
+static bool WriteGPIOAttribute(const char *attribute, const char *value)
+{
+    char path[GPIO_PATH_SIZE];
+    size_t length = strlen(value);
+    bool success;
+    int fd;
+
+    snprintf(path, GPIO_PATH_SIZE, "%s/gpio%s/%s", g_gpioRoot, RELAY_GPIO_PIN, attribute);
+    fd = open(path, O_WRONLY);
+    if (fd == -1)
+    {
+        LOG(LOG_ERR, "Failed to open %s for writing", path);
+        return false;
+    }
+    success = write(fd, value, length) == (ssize_t)length;
+    close(fd);
+    if (!success)
+    {
+        LOG(LOG_ERR, "Failed to write %s", path);
+    }
+    return success;
+}
+
+void ChangeRelayState(bool state)
+{
+    WriteGPIOAttribute("direction", "out");
+    WriteGPIOAttribute("value", state ? "1" : "0");
+
+    LOG(LOG_INFO, "Changed relay state on Ci40 board to %d", state);
+}
+
+/**
+ * @brief Records handler invocation in trace, along with written or returned resource data.
+ */
+static void TraceOperation(AwaOperation operation,
+                           AwaObjectID objectID,
+                           AwaObjectInstanceID objectInstanceID,
+                           AwaResourceID resourceID,
+                           AwaResourceInstanceID resourceInstanceID,
+                           void ** dataPointer,
+                           size_t * dataSize,
+                           AwaResult result)
+{
+    bool hasPayload = operation == AwaOperation_Write ||
+                      (operation == AwaOperation_Read && result == AwaResult_SuccessContent);
+
+    RelayTrace_Record(operation, objectID, objectInstanceID, resourceID, resourceInstanceID,
+                      hasPayload ? *dataPointer : NULL, hasPayload ? *dataSize : 0, result);
+}
+
+static AwaResult HandleRelayState(AwaOperation operation,
+                                  AwaObjectInstanceID objectInstanceID,
+                                  void ** dataPointer,
+                                  size_t * dataSize,
+                                  bool * changed)
+ {
+     bool newState = false;
+     switch (operation)
+     {
+         case AwaOperation_CreateObjectInstance:
+             return AwaResult_SuccessCreated;
+
+         case AwaOperation_CreateResource:
+             return AwaResult_SuccessCreated;
+
+         case AwaOperation_Read:
+             if (ReadGPIO(&g_relayState, atoi(RELAY_GPIO_PIN)) == 0)
+             {
+                 RelayStateShm_Publish(objectInstanceID, g_relayState);
+                 RelayAccounting_NoteState(objectInstanceID, g_relayState);
+                 *dataPointer = &g_relayState;
+                 *dataSize = sizeof(g_relayState);
+                 return AwaResult_SuccessContent;
+             }
+             return AwaResult_InternalError;
+
+         case AwaOperation_Write:
+             newState = **(bool**)dataPointer;
+             if (newState == g_relayState)
+             {
+                 return AwaResult_SuccessChanged;
+             }
+             g_relayState = **(bool**)dataPointer;
+             ApplyState(objectInstanceID, g_relayState);
+             *changed = true;
+             return AwaResult_SuccessChanged;
+
+         default:
+             return AwaResult_MethodNotAllowed;
+     }
+ }
+
+AwaResult RelayStateResourceHandler(AwaStaticClient * client,
+                                       AwaOperation operation,
+                                       AwaObjectID objectID,
+                                       AwaObjectInstanceID objectInstanceID,
+                                       AwaResourceID resourceID,
+                                       AwaResourceInstanceID resourceInstanceID,
+                                       void ** dataPointer,
+                                       size_t * dataSize,
+                                       bool * changed)
+{
+    AwaResult result;
+
+    RelayControl_Lock();
+    result = HandleRelayState(operation, objectInstanceID, dataPointer, dataSize, changed);
+    RelayControl_Unlock();
+    TraceOperation(operation, objectID, objectInstanceID, resourceID, resourceInstanceID,
+                   dataPointer, dataSize, result);
+    return result;
+}
+
+/**
+ * Handles on-time in seconds (5852) and number of off to on transitions (5501). As defined by
+ * IPSO, writing 0 to on-time resets it.
+ */
+static AwaResult HandleRelayAccounting(AwaOperation operation,
+                                       AwaObjectInstanceID objectInstanceID,
+                                       AwaResourceID resourceID,
+                                       void ** dataPointer,
+                                       size_t * dataSize,
+                                       bool * changed)
+ {
+     switch (operation)
+     {
+         case AwaOperation_CreateObjectInstance:
+             return AwaResult_SuccessCreated;
+
+         case AwaOperation_CreateResource:
+             return AwaResult_SuccessCreated;
+
+         case AwaOperation_Read:
+             if (resourceID == ON_TIME_RESOURCE_ID)
+             {
+                 g_accountingValue = RelayAccounting_GetOnTime(objectInstanceID);
+             }
+             else
+             {
+                 g_accountingValue = RelayAccounting_GetCycles(objectInstanceID);
+             }
+             *dataPointer = &g_accountingValue;
+             *dataSize = sizeof(g_accountingValue);
+             return AwaResult_SuccessContent;
+
+         case AwaOperation_Write:
+             if (resourceID != ON_TIME_RESOURCE_ID || **(AwaInteger**)dataPointer != 0)
+             {
+                 return AwaResult_BadRequest;
+             }
+             RelayAccounting_ResetOnTime(objectInstanceID);
+             *changed = true;
+             return AwaResult_SuccessChanged;
+
+         default:
+             return AwaResult_MethodNotAllowed;
+     }
+ }
+
+AwaResult RelayAccountingResourceHandler(AwaStaticClient * client,
+                                            AwaOperation operation,
+                                            AwaObjectID objectID,
+                                            AwaObjectInstanceID objectInstanceID,
+                                            AwaResourceID resourceID,
+                                            AwaResourceInstanceID resourceInstanceID,
+                                            void ** dataPointer,
+                                            size_t * dataSize,
+                                            bool * changed)
+{
+    AwaResult result;
+
+    RelayControl_Lock();
+    result = HandleRelayAccounting(operation, objectInstanceID, resourceID, dataPointer,
+                                   dataSize, changed);
+    RelayControl_Unlock();
+    TraceOperation(operation, objectID, objectInstanceID, resourceID, resourceInstanceID,
+                   dataPointer, dataSize, result);
+    return result;
+}
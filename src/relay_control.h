@@ -0,0 +1,126 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_control.h
+ * @brief Relay resource handlers and GPIO backend driving relay click, shared by relay gateway and
+ *        trace replay tool. Relay output may be driven from connection loss timer thread as well, so
+ *        handlers run under output lock.
+ */
+
+#ifndef RELAY_CONTROL_H
+#define RELAY_CONTROL_H
+
+#include <stdbool.h>
+#include "awa/static.h"
+
+//! @cond Doxygen_Suppress
+#define RELAY_OBJECT_ID             (3201)
+#define RELAY_RESOURCE_ID           (5550)
+#define ON_TIME_RESOURCE_ID         (5852)
+#define CYCLE_COUNTER_RESOURCE_ID   (5501)
+#define RELAY_GPIO_PIN              "73"
+#define DEFAULT_GPIO_ROOT           "/sys/class/gpio"
+//! @endcond
+
+/** Keeps current relay state. */
+extern bool g_relayState;
+
+/**
+ * @brief Sets directory under which GPIO sysfs files are accessed, DEFAULT_GPIO_ROOT by default.
+ * @param *path GPIO sysfs directory, must stay valid while relay is controlled.
+ */
+void RelayControl_SetGPIORoot(const char *path);
+
+/**
+ * @brief Takes relay output lock, which must be held while relay output or published state are
+ *        accessed outside of resource handlers. Accounting counters have their own lock.
+ */
+void RelayControl_Lock(void);
+
+/**
+ * @brief Releases relay output lock.
+ */
+void RelayControl_Unlock(void);
+
+/**
+ * @brief Drives relay instance to given state without changing its commanded state.
+ * @param instanceID relay object instance ID.
+ * @param state to be set on relay
+ */
+void RelayControl_ForceState(unsigned int instanceID, bool state);
+
+/**
+ * @brief Drives relay instance back to its commanded state.
+ * @param instanceID relay object instance ID.
+ */
+void RelayControl_ReassertState(unsigned int instanceID);
+
+/**
+ * Reads current value of specified digital output and stores it on value.
+ * @param *value stores gpio value
+ * @param pin number to read
+ * Returns 0 upon succesfull read, -1 otherwise.
+ */
+int ReadGPIO(bool * value, int pin);
+
+/**
+ * @brief Turn on or off relay on click board depending on specified state.
+ * @param state to be set on relay
+ */
+void ChangeRelayState(bool state);
+
+/**
+ * Gets called whenever any operation on resource /3201/0/5550 is requested
+ */
+AwaResult RelayStateResourceHandler(AwaStaticClient * client,
+                                       AwaOperation operation,
+                                       AwaObjectID objectID,
+                                       AwaObjectInstanceID objectInstanceID,
+                                       AwaResourceID resourceID,
+                                       AwaResourceInstanceID resourceInstanceID,
+                                       void ** dataPointer,
+                                       size_t * dataSize,
+                                       bool * changed);
+
+/**
+ * Gets called whenever any operation on resources /3201/0/5852 or /3201/0/5501 is requested
+ */
+AwaResult RelayAccountingResourceHandler(AwaStaticClient * client,
+                                            AwaOperation operation,
+                                            AwaObjectID objectID,
+                                            AwaObjectInstanceID objectInstanceID,
+                                            AwaResourceID resourceID,
+                                            AwaResourceInstanceID resourceInstanceID,
+                                            void ** dataPointer,
+                                            size_t * dataSize,
+                                            bool * changed);
+
+#endif  /* RELAY_CONTROL_H */
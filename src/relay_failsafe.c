@@ -0,0 +1,229 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_failsafe.c
+ * @brief Connection loss deadline timer. Each Device Server contact pushes deadline forward, timer
+ *        thread sleeps until deadline on CLOCK_MONOTONIC and drives relay outputs to safe state if
+ *        it passes without contact. Timer is armed by first contact, so it never fires when contact
+ *        can't be observed at all.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "relay_failsafe.h"
+#include "relay_control.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Guards all failsafe state below. */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signals timer thread that deadline was re-armed or it should stop. */
+static pthread_cond_t g_wakeup;
+/** Deadline timer thread. */
+static pthread_t g_thread;
+/** Whether timer thread runs. */
+static bool g_running = false;
+/** Whether Device Server contact was seen since start. */
+static bool g_armed = false;
+/** Whether instances are held in safe state. */
+static bool g_active = false;
+/** Number of relay instances. */
+static unsigned int g_numInstances = 0;
+/** Safe state of each instance. */
+static bool g_safeStates[RELAY_FAILSAFE_MAX_INSTANCES];
+/** Allowed time without Device Server contact. */
+static unsigned int g_timeoutMs = 0;
+/** CLOCK_MONOTONIC time of last Device Server contact. */
+static struct timespec g_lastContact;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+/**
+ * @brief Returns time of last contact plus timeout.
+ */
+static struct timespec GetDeadline(void)
+{
+    struct timespec deadline = g_lastContact;
+    deadline.tv_sec += g_timeoutMs / 1000;
+    deadline.tv_nsec += (long)(g_timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+static bool IsReached(const struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec > deadline->tv_sec ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
+
+static void *DeadlineTimer(void *context)
+{
+    struct timespec deadline;
+    unsigned int i;
+
+    pthread_mutex_lock(&g_lock);
+    while (g_running)
+    {
+        if (!g_armed || g_active)
+        {
+            pthread_cond_wait(&g_wakeup, &g_lock);
+            continue;
+        }
+
+        deadline = GetDeadline();
+        if (!IsReached(&deadline))
+        {
+            pthread_cond_timedwait(&g_wakeup, &g_lock, &deadline);
+            continue;
+        }
+
+        /* Outputs are driven with lock held, so contact noted meanwhile re-asserts after this. */
+        g_active = true;
+        LOG(LOG_WARN, "No Device Server contact for %u ms, driving relay to safe state.",
+            g_timeoutMs);
+        for (i = 0; i < g_numInstances; i++)
+        {
+            RelayControl_ForceState(i, g_safeStates[i]);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+bool RelayFailsafe_Start(unsigned int numInstances, const bool *safeStates, unsigned int timeoutMs)
+{
+    pthread_condattr_t attr;
+
+    if (numInstances > RELAY_FAILSAFE_MAX_INSTANCES || timeoutMs == 0)
+    {
+        return false;
+    }
+
+    g_numInstances = numInstances;
+    memcpy(g_safeStates, safeStates, numInstances * sizeof(*safeStates));
+    g_timeoutMs = timeoutMs;
+    g_armed = false;
+    g_active = false;
+    clock_gettime(CLOCK_MONOTONIC, &g_lastContact);
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_wakeup, &attr);
+    pthread_condattr_destroy(&attr);
+
+    g_running = true;
+    if (pthread_create(&g_thread, NULL, DeadlineTimer, NULL) != 0)
+    {
+        LOG(LOG_ERR, "Failed to start connection loss timer.");
+        g_running = false;
+        pthread_cond_destroy(&g_wakeup);
+        return false;
+    }
+    LOG(LOG_INFO, "Relay goes to safe state after %u ms without Device Server contact.", timeoutMs);
+    return true;
+}
+
+void RelayFailsafe_Kick(void)
+{
+    bool wasActive;
+    unsigned int i;
+
+    pthread_mutex_lock(&g_lock);
+    if (!g_running)
+    {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &g_lastContact);
+    wasActive = g_active;
+    g_active = false;
+    if (!g_armed || wasActive)
+    {
+        if (!g_armed)
+        {
+            LOG(LOG_INFO, "Device Server contact seen, connection loss timer armed.");
+        }
+        g_armed = true;
+        pthread_cond_signal(&g_wakeup);
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    if (wasActive)
+    {
+        LOG(LOG_INFO, "Device Server contact restored, re-asserting commanded relay state.");
+        for (i = 0; i < g_numInstances; i++)
+        {
+            RelayControl_ReassertState(i);
+        }
+    }
+}
+
+bool RelayFailsafe_IsActive(void)
+{
+    bool active;
+
+    pthread_mutex_lock(&g_lock);
+    active = g_active;
+    pthread_mutex_unlock(&g_lock);
+    return active;
+}
+
+void RelayFailsafe_Stop(void)
+{
+    pthread_mutex_lock(&g_lock);
+    if (!g_running)
+    {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_running = false;
+    pthread_cond_signal(&g_wakeup);
+    pthread_mutex_unlock(&g_lock);
+
+    pthread_join(g_thread, NULL);
+    pthread_cond_destroy(&g_wakeup);
+}
@@ -0,0 +1,74 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_failsafe.h
+ * @brief Drives relay instances to configured safe state when Device Server connection is lost and
+ *        re-asserts commanded state once it is back.
+ */
+
+#ifndef RELAY_FAILSAFE_H
+#define RELAY_FAILSAFE_H
+
+#include <stdbool.h>
+
+//! \{
+#define RELAY_FAILSAFE_MAX_INSTANCES    (8)
+//! \}
+
+/**
+ * @brief Starts connection loss deadline timer. Timer runs in its own thread, so failover latency
+ *        does not depend on main loop sleeps. Deadline is enforced only after first Device Server
+ *        contact.
+ * @param numInstances number of relay instances.
+ * @param *safeStates safe state of each instance.
+ * @param timeoutMs time without Device Server contact after which instances are driven to safe
+ *        state.
+ * @return true if timer was started, false otherwise.
+ */
+bool RelayFailsafe_Start(unsigned int numInstances, const bool *safeStates, unsigned int timeoutMs);
+
+/**
+ * @brief Notes Device Server contact, restarting deadline. If instances are in safe state, their
+ *        commanded state is re-asserted before returning. Does nothing if timer is not started.
+ */
+void RelayFailsafe_Kick(void);
+
+/**
+ * @brief Returns true while instances are held in safe state.
+ */
+bool RelayFailsafe_IsActive(void);
+
+/**
+ * @brief Stops deadline timer.
+ */
+void RelayFailsafe_Stop(void);
+
+#endif  /* RELAY_FAILSAFE_H */
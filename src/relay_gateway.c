@@ -48,6 +48,13 @@
 #include <libconfig.h>
 #include "awa/static.h"
 #include "log.h"
+#include "relay_state_shm.h"
+#include "relay_accounting.h"
+#include "relay_control.h"
+#include "relay_trace.h"
+#include "relay_failsafe.h"
+#include "relay_liveness.h"
+#include "relay_idle.h"
 
 /***************************************************************************************************
  * Definitions
@@ -60,29 +67,23 @@
 #define IP_ADDRESS                  "127.0.0.1"
 #define RELAY_STATE                 "DigitalOutputState"
 #define RELAY_OBJECT_NAME           "Relay"
-#define RELAY_OBJECT_ID             (3201)
-#define RELAY_RESOURCE_ID           (5550)
+#define ON_TIME                     "OnTime"
+#define CYCLE_COUNTER               "DigitalInputCounter"
 #define MIN_INSTANCES               (0)
 #define MAX_INSTANCES               (1)
 #define OPERATION_TIMEOUT           (5000)
 #define URL_PATH_SIZE               (16)
-#define RELAY_GPIO_PIN              "73"
 #define CLIENT_NAME                 "RelayDevice"
 #define CLIENT_COAP_PORT            (6001)
 #define DEFAULT_PATH_CONFIG_FILE    "/etc/config/relay_gateway.cfg"
+#define DEFAULT_ACCOUNTING_FILE     "/etc/config/relay_gateway.acc"
+#define DEFAULT_ACCOUNTING_INTERVAL (600)
+#define DEFAULT_IDLE_SLACK          (100)
+#define DEFAULT_IDLE_MAX_SLEEP      (5000)
+#define CERT_POLL_INTERVAL          (2)
 
 //! @endcond
 
-static AwaResult RelayStateResourceHandler(client,
-                                              operation,
-                                              objectID,
-                                              objectInstanceID,
-                                              resourceID,
-                                              resourceInstanceID,
-                                              dataPointer,
-                                              dataSize,
-                                              changed);
-
 /***************************************************************************************************
  * Typedef
  **************************************************************************************************/
@@ -130,14 +131,28 @@ int g_debugLevel = LOG_INFO;
 FILE * g_debugStream = NULL;
 /** Determines whether we should keep main loop running. */
 static volatile int g_keepRunning = 1;
-/** Keeps current relay state. */
-bool g_relayState = false;
 /** Keeps certificate */
 char *g_cert = NULL;
 /** Keeps bootstrap server url */
 const char *g_bootstrapServerUrl = NULL;
 /** Keeps path to certificate file */
 char *g_certFilePath = NULL;
+/** Keeps path to relay accounting file */
+const char *g_accountingFilePath = DEFAULT_ACCOUNTING_FILE;
+/** Keeps minimal interval in seconds between relay accounting file writes */
+int g_accountingInterval = DEFAULT_ACCOUNTING_INTERVAL;
+/** Keeps time in ms without Device Server contact after which relay goes to safe state, 0 disables it */
+int g_connectionLossTimeout = 0;
+/** Keeps safe state of each relay instance */
+bool g_safeStates[MAX_INSTANCES] = { false };
+/** Determines whether main loop sleeps until next deadline instead of waking up every second */
+int g_idleMode = false;
+/** Keeps time in ms by which deadline may be postponed to share wakeup in idle mode */
+int g_idleSlack = DEFAULT_IDLE_SLACK;
+/** Keeps longest sleep in ms in idle mode */
+int g_idleMaxSleep = DEFAULT_IDLE_MAX_SLEEP;
+/** Keeps path to handler trace file, NULL if tracing is off */
+const char *g_traceFilePath = NULL;
 
 config_t cfg;
 
@@ -149,9 +164,9 @@ static Object objects[] =
         RELAY_OBJECT_ID,
         0,
         RELAY_OBJECT_NAME,
-        1,
+        3,
         (Resource []){
-
+                          {
                             RELAY_RESOURCE_ID,
                             0,
                             AwaResourceType_Boolean,
@@ -159,6 +174,25 @@ static Object objects[] =
                             true,
                             AwaResourceOperations_ReadWrite,
                             RelayStateResourceHandler,
+                          },
+                          {
+                            ON_TIME_RESOURCE_ID,
+                            0,
+                            AwaResourceType_Integer,
+                            ON_TIME,
+                            true,
+                            AwaResourceOperations_ReadWrite,
+                            RelayAccountingResourceHandler,
+                          },
+                          {
+                            CYCLE_COUNTER_RESOURCE_ID,
+                            0,
+                            AwaResourceType_Integer,
+                            CYCLE_COUNTER,
+                            true,
+                            AwaResourceOperations_ReadOnly,
+                            RelayAccountingResourceHandler,
+                          },
                        },
     }
 };
@@ -167,79 +201,6 @@ static Object objects[] =
  * Implementation
  **************************************************************************************************/
 
-/**
- * Reads current value of specified digital output and stores it on value.
- * @param *value stores gpio value
- * @param pin number to read
- * Returns 0 upon succesfull read, -1 otherwise.
- */
-static int ReadGPIO(bool * value, int pin)
-{
-    const int VALUE_MAX = 30;
-    char path[VALUE_MAX];
-    char valueStr[3];
-    int fd;
-    snprintf(path, VALUE_MAX, "/sys/class/gpio/gpio%d/value", pin);
-    fd = open(path, O_RDONLY);
-    if (-1 == fd) {
-        LOG(LOG_ERR, "Failed to open gpio value for reading!\n");
-        return(-1);
-    }
-
-    if (-1 == read(fd, valueStr, 3)) {
-        LOG(LOG_ERR, "Failed to read value!\n");
-        return(-1);
-    }
-    close(fd);
-    *value = (bool)!!atoi(valueStr);
-    return 0;
-}
-
-/**
- * Gets called whenever any operation on resource /3201/0/5550 is requested
- */
-static AwaResult RelayStateResourceHandler(AwaStaticClient * client,
-                                               AwaOperation operation,
-                                               AwaObjectID objectID,
-                                               AwaObjectInstanceID objectInstanceID,
-                                               AwaResourceID resourceID,
-                                               AwaResourceInstanceID resourceInstanceID,
-                                               void ** dataPointer,
-                                               size_t * dataSize,
-                                               bool * changed)
- {
-     bool newState = false;
-     switch (operation)
-     {
-         case AwaOperation_CreateObjectInstance:
-             return AwaResult_SuccessCreated;
-
-         case AwaOperation_CreateResource:
-             return AwaResult_SuccessCreated;
-
-         case AwaOperation_Read:
-             if (ReadGPIO(&g_relayState, atoi(RELAY_GPIO_PIN)) == 0)
-             {
-                 *dataPointer = &g_relayState;
-                 *dataSize = sizeof(g_relayState);
-                 return AwaResult_SuccessContent;
-             }
-             return AwaResult_InternalError;
-
-         case AwaOperation_Write:
-             newState = **(bool**)dataPointer;
-             if (newState == g_relayState)
-             {
-                 return AwaResult_SuccessChanged;
-             }
-             g_relayState = **(bool**)dataPointer;
-             ChangeRelayState(g_relayState);
-             *changed = true;
-             return AwaResult_SuccessChanged;
-
-     }
- }
-
 /**
  * @brief Prints relay_gateway_appd usage.
  * @param *program holds application name.
@@ -251,6 +212,7 @@ static void PrintUsage(const char *program)
         " -v : Debug level from 1 to 5\n"
         "      fatal(1), error(2), warning(3), info(4), debug(5) and max(>5)\n"
         "      default is info.\n"
+        " -t : Record resource handler trace to given file, see relay_replay.\n"
         " -h : Print help and exit.\n\n",
         program);
 }
@@ -293,6 +255,8 @@ bool ReadCertificate(const char *filePath, char **certificate) {
  * @return true on succesfull readm false otherwise
  */
 bool ReadConfigFile(const char *filePath) {
+    config_setting_t *safeStates;
+    int i;
 
 
     config_init(&cfg);
@@ -311,6 +275,27 @@ bool ReadConfigFile(const char *filePath) {
         LOG(LOG_ERR, "Config file does not contain CERT_FILE_PATH property.");
         return false;
     }
+    /* Optional properties, defaults are used when missing. */
+    config_lookup_string(&cfg, "ACCOUNTING_FILE_PATH", &g_accountingFilePath);
+    config_lookup_int(&cfg, "ACCOUNTING_FLUSH_INTERVAL", &g_accountingInterval);
+    if (g_accountingInterval <= 0)
+    {
+        /* Flushing on every loop pass would wear out flash, negative value would never flush. */
+        LOG(LOG_WARN, "Invalid ACCOUNTING_FLUSH_INTERVAL %d, using %d s.", g_accountingInterval,
+            DEFAULT_ACCOUNTING_INTERVAL);
+        g_accountingInterval = DEFAULT_ACCOUNTING_INTERVAL;
+    }
+    config_lookup_int(&cfg, "CONNECTION_LOSS_TIMEOUT_MS", &g_connectionLossTimeout);
+    config_lookup_bool(&cfg, "IDLE_MODE", &g_idleMode);
+    config_lookup_int(&cfg, "IDLE_SLACK_MS", &g_idleSlack);
+    config_lookup_int(&cfg, "IDLE_MAX_SLEEP_MS", &g_idleMaxSleep);
+    if ((safeStates = config_lookup(&cfg, "SAFE_STATES")) != NULL)
+    {
+        for (i = 0; i < MAX_INSTANCES && i < config_setting_length(safeStates); i++)
+        {
+            g_safeStates[i] = config_setting_get_bool_elem(safeStates, i);
+        }
+    }
 
     return true;
 }
@@ -328,7 +313,7 @@ static int ParseCommandArgs(int argc, char *argv[], const char **fptr)
 
     while (1)
     {
-    	opt = getopt(argc, argv, "l:v:c:");
+    	opt = getopt(argc, argv, "l:v:c:t:");
 	if (opt == -1)
 	{
             break;
@@ -357,6 +342,10 @@ static int ParseCommandArgs(int argc, char *argv[], const char **fptr)
                 PrintUsage(argv[0]);
                 return 0;
 
+            case 't':
+                g_traceFilePath = optarg;
+                break;
+
             case 'c':
                 configFilePath = malloc(strlen(optarg));
                 sprintf(configFilePath, "%s", optarg);
@@ -393,22 +382,6 @@ static void CtrlCHandler(int signal) {
 }
 
 
-/**
- * @brief Turn on or off relay on click board depending on specified state.
- * @param state to be set on relay
- */
-void ChangeRelayState(bool state)
-{
-    system("echo out > /sys/class/gpio/gpio73/direction");
-    if(state)
-        system("echo 1 > /sys/class/gpio/gpio73/value");
-    else
-        system("echo 0 > /sys/class/gpio/gpio73/value");
-
-    LOG(LOG_INFO, "Changed relay state on Ci40 board to %d", state);
-}
-
-
 /**
  * @brief Add all resource definitions that belong to object.
  * @param *object whose resources are to be defined.
@@ -422,8 +395,9 @@ static bool AddResourceDefinitions(AwaStaticClient *client, Object *object)
     /*define resources*/
      for (i = 0; i < object->numResources; i++)
      {
-         /* For this application only boolean resources are handled */
-         if (object->resources[i].type == AwaResourceType_Boolean)
+         /* For this application only boolean and integer resources are handled */
+         if (object->resources[i].type == AwaResourceType_Boolean ||
+             object->resources[i].type == AwaResourceType_Integer)
          {
              if ((error = AwaStaticClient_DefineResource(client,
                                             object->id,
@@ -615,10 +589,23 @@ int main(int argc, char **argv)
         g_keepRunning = false;
     }
 
+    if (g_idleMode)
+    {
+        RelayIdle_Init(g_idleSlack, g_idleMaxSleep);
+    }
+
     LOG(LOG_INFO, "Looking for certificate file under : %s", g_certFilePath);
     while (!ReadCertificate(g_certFilePath, &g_cert))
     {
-        sleep(2);
+        if (g_idleMode)
+        {
+            RelayIdle_WaitForFile(g_certFilePath, g_idleMaxSleep);
+        }
+        else
+        {
+            sleep(CERT_POLL_INTERVAL);
+            RelayIdle_NoteWakeup();
+        }
         if (g_keepRunning == false)
         {
             break;
@@ -644,6 +631,11 @@ int main(int argc, char **argv)
         g_keepRunning = false;
     }
 
+    if (g_keepRunning && g_traceFilePath != NULL && !RelayTrace_Start(g_traceFilePath))
+    {
+        LOG(LOG_WARN, "Handler invocations won't be traced.");
+    }
+
     if (g_keepRunning && !SetResourceOperationHandlers(staticClient))
     {
         LOG(LOG_ERR, "Failed to subscribe to relay state change. Exiting...");
@@ -658,20 +650,65 @@ int main(int argc, char **argv)
 
     if (g_keepRunning)
     {
+        if (!RelayStateShm_Create(RELAY_STATE_SHM_NAME, MAX_INSTANCES))
+        {
+            LOG(LOG_WARN, "Relay state won't be available to local readers.");
+        }
+        RelayAccounting_Init(g_accountingFilePath, MAX_INSTANCES, g_accountingInterval);
+        if (ReadGPIO(&g_relayState, atoi(RELAY_GPIO_PIN)) == 0)
+        {
+            RelayStateShm_Publish(objects[0].instanceID, g_relayState);
+            RelayAccounting_NoteState(objects[0].instanceID, g_relayState);
+        }
+        if (g_connectionLossTimeout > 0 &&
+            !RelayFailsafe_Start(MAX_INSTANCES, g_safeStates, g_connectionLossTimeout))
+        {
+            LOG(LOG_WARN, "Relay won't go to safe state on connection loss.");
+        }
+        /* Client socket feeds connection loss timer and wakes up idle main loop on request. */
+        if (g_connectionLossTimeout > 0 || g_idleMode)
+        {
+            RelayLiveness_Watch(CLIENT_COAP_PORT);
+        }
         LOG(LOG_INFO, "Observing IPSO object on path /3201/0/5550");
     }
 
 
     while (g_keepRunning) {
-        AwaStaticClient_Process(staticClient);
-        sleep(1);
+        int nextProcess = AwaStaticClient_Process(staticClient);
+        uint64_t nextFlush;
+
+        /* Not under output lock, failover must not wait for flash write. */
+        RelayAccounting_Process();
+        nextFlush = RelayAccounting_GetNextFlush();
+
+        if (g_idleMode)
+        {
+            /* Awa reports time until its next protocol timer, 0 when work is already due. Negative
+             * value tells nothing, so client is checked again after longest sleep. */
+            RelayIdle_AddDeadline(RelayIdle_Now() +
+                                  (nextProcess >= 0 ? (unsigned int)nextProcess : g_idleMaxSleep));
+            RelayIdle_AddDeadline(nextFlush);
+            RelayIdle_Sleep(RelayLiveness_GetSocket());
+        }
+        else
+        {
+            sleep(1);
+            RelayIdle_NoteWakeup();
+        }
     }
 
+    RelayFailsafe_Stop();
+
     if (staticClient != NULL)
     {
         AwaStaticClient_Free(&staticClient);
     }
 
+    RelayStateShm_Destroy();
+    RelayAccounting_Deinit();
+    RelayTrace_Stop();
+
     if (g_cert != NULL)
     {
         free(g_cert);
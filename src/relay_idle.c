@@ -0,0 +1,224 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_idle.c
+ * @brief Sleeps until next required wakeup and keeps wakeups per minute statistics.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+#include "relay_idle.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define MAX_DEADLINES               (8)
+#define STATISTICS_PERIOD_MS        (60000)
+//! @endcond
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Deadlines collected for next sleep. */
+static uint64_t g_deadlines[MAX_DEADLINES];
+/** Number of collected deadlines. */
+static unsigned int g_numDeadlines = 0;
+/** How much deadline may be postponed to share wakeup. */
+static unsigned int g_slackMs = 0;
+/** Longest sleep. */
+static unsigned int g_maxSleepMs = 1000;
+/** Wakeups since start of current statistics period. */
+static unsigned int g_wakeups = 0;
+/** Start of current statistics period. */
+static uint64_t g_periodStartMs = 0;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+void RelayIdle_Init(unsigned int slackMs, unsigned int maxSleepMs)
+{
+    g_slackMs = slackMs;
+    g_maxSleepMs = maxSleepMs;
+    g_numDeadlines = 0;
+
+    LOG(LOG_INFO, "Idle mode enabled, slack %u ms, longest sleep %u ms.", slackMs, maxSleepMs);
+}
+
+uint64_t RelayIdle_Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void RelayIdle_AddDeadline(uint64_t deadlineMs)
+{
+    if (deadlineMs == RELAY_IDLE_NO_DEADLINE)
+    {
+        return;
+    }
+    if (g_numDeadlines == MAX_DEADLINES)
+    {
+        LOG(LOG_WARN, "Too many idle deadlines, waking up early.");
+        g_deadlines[0] = RelayIdle_Now();
+        g_numDeadlines = 1;
+        return;
+    }
+    g_deadlines[g_numDeadlines++] = deadlineMs;
+}
+
+void RelayIdle_NoteWakeup(void)
+{
+    uint64_t now = RelayIdle_Now();
+
+    if (g_periodStartMs == 0)
+    {
+        g_periodStartMs = now;
+    }
+    g_wakeups++;
+    if (now - g_periodStartMs >= STATISTICS_PERIOD_MS)
+    {
+        LOG(LOG_INFO, "Wakeups per minute: %.1f",
+            g_wakeups * 60000.0 / (double)(now - g_periodStartMs));
+        g_wakeups = 0;
+        g_periodStartMs = now;
+    }
+}
+
+/**
+ * @brief Picks wakeup time. Earliest deadline may be postponed by up to slack, so wakeup lands on
+ *        the latest deadline within that window and serves all of them at once.
+ * @param limit latest wakeup, RELAY_IDLE_NO_DEADLINE for none.
+ */
+static uint64_t GetWakeupTime(uint64_t limit)
+{
+    uint64_t earliest = limit;
+    uint64_t wakeup;
+    unsigned int i;
+
+    for (i = 0; i < g_numDeadlines; i++)
+    {
+        if (g_deadlines[i] < earliest)
+        {
+            earliest = g_deadlines[i];
+        }
+    }
+    if (earliest == RELAY_IDLE_NO_DEADLINE)
+    {
+        return earliest;
+    }
+    wakeup = earliest;
+    for (i = 0; i < g_numDeadlines; i++)
+    {
+        if (g_deadlines[i] > wakeup && g_deadlines[i] <= earliest + g_slackMs)
+        {
+            wakeup = g_deadlines[i];
+        }
+    }
+    return wakeup < limit ? wakeup : limit;
+}
+
+void RelayIdle_Sleep(int fd)
+{
+    uint64_t now = RelayIdle_Now();
+    uint64_t wakeup = GetWakeupTime(fd == -1 ? now + g_maxSleepMs : RELAY_IDLE_NO_DEADLINE);
+    struct pollfd pfd;
+    struct timespec ts;
+
+    g_numDeadlines = 0;
+    if (fd != -1 && wakeup > now)
+    {
+        /* Incoming request wakes up immediately, so it doesn't wait for next deadline. */
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        poll(&pfd, 1, wakeup == RELAY_IDLE_NO_DEADLINE ? -1 :
+             wakeup - now > INT_MAX ? INT_MAX : (int)(wakeup - now));
+        RelayIdle_NoteWakeup();
+    }
+    else if (wakeup > now)
+    {
+        ts.tv_sec = wakeup / 1000;
+        ts.tv_nsec = (long)(wakeup % 1000) * 1000000;
+        /* Interrupted sleep returns, so caller can react to exit signal. */
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        RelayIdle_NoteWakeup();
+    }
+}
+
+void RelayIdle_WaitForFile(const char *filePath, unsigned int timeoutMs)
+{
+    char directory[PATH_MAX];
+    struct pollfd pfd;
+    int timeout = timeoutMs > INT_MAX ? INT_MAX : (int)timeoutMs;
+
+    strncpy(directory, filePath, sizeof(directory) - 1);
+    directory[sizeof(directory) - 1] = '\0';
+
+    pfd.fd = inotify_init1(IN_CLOEXEC);
+    pfd.events = POLLIN;
+    if (pfd.fd == -1 ||
+        inotify_add_watch(pfd.fd, dirname(directory), IN_MOVED_TO | IN_CLOSE_WRITE) == -1)
+    {
+        LOG(LOG_DBG, "Can't watch for %s, sleeping instead.", filePath);
+        if (pfd.fd != -1)
+        {
+            close(pfd.fd);
+        }
+        struct timespec ts = { timeout / 1000, (long)(timeout % 1000) * 1000000 };
+        nanosleep(&ts, NULL);
+        RelayIdle_NoteWakeup();
+        return;
+    }
+
+    /* File may have appeared before watch was set up, caller checks it again anyway. Only complete
+     * files are waited for, creation alone would let caller read certificate still being written. */
+    if (access(filePath, R_OK) != 0)
+    {
+        poll(&pfd, 1, timeout);
+        RelayIdle_NoteWakeup();
+    }
+    close(pfd.fd);
+}
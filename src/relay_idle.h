@@ -0,0 +1,90 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_idle.h
+ * @brief Low-power idle scheduling. Instead of waking up periodically, main loop collects all
+ *        pending deadlines and sleeps until the next one, coalescing deadlines that fall within
+ *        slack window into single wakeup. Wakeups per minute are reported in both idle and regular
+ *        mode, so effect of idle mode can be compared.
+ */
+
+#ifndef RELAY_IDLE_H
+#define RELAY_IDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! \{
+#define RELAY_IDLE_NO_DEADLINE      (UINT64_MAX)
+//! \}
+
+/**
+ * @brief Configures idle scheduling.
+ * @param slackMs how much deadline may be postponed to share wakeup with later deadline.
+ * @param maxSleepMs longest sleep while client socket is unknown, bounds latency of work which has
+ *        no deadline (e.g. incoming Device Server requests).
+ */
+void RelayIdle_Init(unsigned int slackMs, unsigned int maxSleepMs);
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in milliseconds, time base of all deadlines.
+ */
+uint64_t RelayIdle_Now(void);
+
+/**
+ * @brief Adds deadline for next sleep.
+ * @param deadlineMs CLOCK_MONOTONIC time in milliseconds, RELAY_IDLE_NO_DEADLINE is ignored.
+ */
+void RelayIdle_AddDeadline(uint64_t deadlineMs);
+
+/**
+ * @brief Sleeps until next coalesced deadline and clears deadlines. Returns early on signal or
+ *        when socket becomes readable.
+ * @param fd socket of incoming requests, -1 if unknown, in which case sleep is bounded by longest
+ *        sleep instead.
+ */
+void RelayIdle_Sleep(int fd);
+
+/**
+ * @brief Counts wakeup after sleep and reports number of wakeups per minute once a minute. Report
+ *        piggybacks on regular wakeups, so statistics themselves don't wake CPU.
+ */
+void RelayIdle_NoteWakeup(void);
+
+/**
+ * @brief Waits until file is completely written (closed after writing or moved in place) or
+ *        timeout passes, without periodic polling.
+ * @param *filePath file to wait for.
+ * @param timeoutMs longest wait.
+ */
+void RelayIdle_WaitForFile(const char *filePath, unsigned int timeoutMs);
+
+#endif  /* RELAY_IDLE_H */
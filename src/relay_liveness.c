@@ -0,0 +1,380 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_liveness.c
+ * @brief Interposes socket send and receive functions used by Awa static client library. Datagram
+ *        received on watched port counts as Device Server contact if it comes from peer client
+ *        socket sent to before. Must be linked into executable, so its definitions take precedence
+ *        over C library ones.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "relay_liveness.h"
+#include "relay_failsafe.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define MAX_PEERS                   (4)
+//! @endcond
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Local port of watched socket, 0 when nothing is watched. */
+static volatile unsigned short g_watchedPort = 0;
+/** Last socket seen bound to watched port, -1 until client uses it. */
+static volatile int g_socket = -1;
+/** Addresses watched socket sent datagrams to, i.e. bootstrap and Device Server. */
+static struct sockaddr_storage g_peers[MAX_PEERS];
+/** Number of valid entries in g_peers. */
+static unsigned int g_numPeers = 0;
+/** Entry of g_peers replaced by next new peer once table is full. */
+static unsigned int g_nextPeer = 0;
+/** Protects peer table, socket functions may be called from any thread. */
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+void RelayLiveness_Watch(unsigned short port)
+{
+    g_watchedPort = port;
+}
+
+/**
+ * @brief Returns true if socket is bound to watched port. Other sockets (e.g. DNS resolver ones)
+ *        say nothing about Device Server.
+ */
+static bool IsBoundToWatchedPort(int fd)
+{
+    struct sockaddr_storage address;
+    socklen_t length = sizeof(address);
+
+    if (g_watchedPort == 0 || getsockname(fd, (struct sockaddr *)&address, &length) != 0)
+    {
+        return false;
+    }
+    switch (address.ss_family)
+    {
+        case AF_INET:
+            return ntohs(((struct sockaddr_in *)&address)->sin_port) == g_watchedPort;
+
+        case AF_INET6:
+            return ntohs(((struct sockaddr_in6 *)&address)->sin6_port) == g_watchedPort;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Like IsBoundToWatchedPort, also remembers matching socket for RelayLiveness_GetSocket.
+ */
+static bool IsWatched(int fd)
+{
+    if (!IsBoundToWatchedPort(fd))
+    {
+        return false;
+    }
+    g_socket = fd;
+    return true;
+}
+
+int RelayLiveness_GetSocket(void)
+{
+    int fd = g_socket;
+
+    /* Client may have closed socket since and descriptor may be reused by anything else. */
+    if (fd != -1 && !IsBoundToWatchedPort(fd))
+    {
+        g_socket = -1;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Returns true if both addresses have the same family, host and port.
+ */
+static bool IsSameAddress(const struct sockaddr_storage *a, const struct sockaddr *b)
+{
+    const struct sockaddr_in *a4 = (const struct sockaddr_in *)a, *b4 = (const struct sockaddr_in *)b;
+    const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a, *b6 = (const struct sockaddr_in6 *)b;
+
+    if (a->ss_family != b->sa_family)
+    {
+        return false;
+    }
+    switch (a->ss_family)
+    {
+        case AF_INET:
+            return a4->sin_port == b4->sin_port && a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+
+        case AF_INET6:
+            return a6->sin6_port == b6->sin6_port &&
+                   memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr)) == 0;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Looks up address in peer table. Must be called with g_lock held.
+ */
+static bool IsPeer(const struct sockaddr *address)
+{
+    unsigned int i;
+
+    for (i = 0; i < g_numPeers; i++)
+    {
+        if (IsSameAddress(&g_peers[i], address))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Returns peer of connected socket in address, or NULL if socket is not connected.
+ */
+static const struct sockaddr *GetPeerName(int fd, struct sockaddr_storage *address)
+{
+    socklen_t length = sizeof(*address);
+
+    if (getpeername(fd, (struct sockaddr *)address, &length) != 0)
+    {
+        return NULL;
+    }
+    return (const struct sockaddr *)address;
+}
+
+/**
+ * @brief Remembers destination of datagram sent from watched socket, so its responses are
+ *        recognised. Connected socket sends to its peer.
+ */
+static void NoteSent(int fd, ssize_t size, const struct sockaddr *address, socklen_t length)
+{
+    struct sockaddr_storage peer;
+    int savedErrno = errno;
+
+    if (size >= 0 && IsWatched(fd))
+    {
+        if (address == NULL || length == 0)
+        {
+            address = GetPeerName(fd, &peer);
+            length = sizeof(peer);
+        }
+        if (address != NULL && length <= sizeof(g_peers[0]) &&
+            (address->sa_family == AF_INET || address->sa_family == AF_INET6))
+        {
+            pthread_mutex_lock(&g_lock);
+            if (!IsPeer(address))
+            {
+                memset(&g_peers[g_nextPeer], 0, sizeof(g_peers[0]));
+                memcpy(&g_peers[g_nextPeer], address, length);
+                g_nextPeer = (g_nextPeer + 1) % MAX_PEERS;
+                if (g_numPeers < MAX_PEERS)
+                {
+                    g_numPeers++;
+                }
+            }
+            pthread_mutex_unlock(&g_lock);
+        }
+    }
+    errno = savedErrno;
+}
+
+/**
+ * @brief Notes Device Server contact if datagram was received on watched socket from known peer.
+ *        Any other sender, which could be any host able to reach the port, is ignored.
+ */
+static void NoteReceived(int fd, ssize_t size, const struct sockaddr *address)
+{
+    struct sockaddr_storage peer;
+    bool isPeer = false;
+    int savedErrno = errno;
+
+    /* Empty receive only tells which socket is client's, until that is known. */
+    if (size <= 0 && g_socket == -1 && g_watchedPort != 0)
+    {
+        IsWatched(fd);
+    }
+    else if (size > 0 && IsWatched(fd))
+    {
+        if (address == NULL)
+        {
+            address = GetPeerName(fd, &peer);
+        }
+        if (address != NULL)
+        {
+            pthread_mutex_lock(&g_lock);
+            isPeer = IsPeer(address);
+            pthread_mutex_unlock(&g_lock);
+        }
+        if (isPeer)
+        {
+            RelayFailsafe_Kick();
+        }
+    }
+    errno = savedErrno;
+}
+
+ssize_t recvfrom(int fd, void *buffer, size_t length, int flags, struct sockaddr *address,
+                 socklen_t *addressLength)
+{
+    static ssize_t (*realRecvfrom)(int, void *, size_t, int, struct sockaddr *, socklen_t *);
+    struct sockaddr_storage sender;
+    socklen_t senderLength = sizeof(sender);
+    ssize_t size;
+
+    if (realRecvfrom == NULL)
+    {
+        realRecvfrom = dlsym(RTLD_NEXT, "recvfrom");
+    }
+    if (address == NULL)
+    {
+        /* Caller doesn't need sender, but it is needed to tell server from anyone else. */
+        size = realRecvfrom(fd, buffer, length, flags, (struct sockaddr *)&sender, &senderLength);
+        NoteReceived(fd, size, size >= 0 ? (struct sockaddr *)&sender : NULL);
+    }
+    else
+    {
+        /* Sender truncated to caller's buffer can't be compared. */
+        senderLength = *addressLength;
+        size = realRecvfrom(fd, buffer, length, flags, address, addressLength);
+        NoteReceived(fd, size, size >= 0 && *addressLength <= senderLength ? address : NULL);
+    }
+    return size;
+}
+
+ssize_t recv(int fd, void *buffer, size_t length, int flags)
+{
+    static ssize_t (*realRecv)(int, void *, size_t, int);
+    ssize_t size;
+
+    if (realRecv == NULL)
+    {
+        realRecv = dlsym(RTLD_NEXT, "recv");
+    }
+    size = realRecv(fd, buffer, length, flags);
+    NoteReceived(fd, size, NULL);
+    return size;
+}
+
+ssize_t recvmsg(int fd, struct msghdr *message, int flags)
+{
+    static ssize_t (*realRecvmsg)(int, struct msghdr *, int);
+    struct sockaddr_storage sender;
+    void *name = message->msg_name;
+    socklen_t nameLength = message->msg_namelen;
+    ssize_t size;
+
+    if (realRecvmsg == NULL)
+    {
+        realRecvmsg = dlsym(RTLD_NEXT, "recvmsg");
+    }
+    if (name == NULL)
+    {
+        message->msg_name = &sender;
+        message->msg_namelen = sizeof(sender);
+    }
+    size = realRecvmsg(fd, message, flags);
+    NoteReceived(fd, size, size >= 0 &&
+                 message->msg_namelen <= (name == NULL ? sizeof(sender) : nameLength) ?
+                 (struct sockaddr *)message->msg_name : NULL);
+    if (name == NULL)
+    {
+        message->msg_name = NULL;
+        message->msg_namelen = nameLength;
+    }
+    return size;
+}
+
+ssize_t sendto(int fd, const void *buffer, size_t length, int flags,
+               const struct sockaddr *address, socklen_t addressLength)
+{
+    static ssize_t (*realSendto)(int, const void *, size_t, int, const struct sockaddr *, socklen_t);
+    ssize_t size;
+
+    if (realSendto == NULL)
+    {
+        realSendto = dlsym(RTLD_NEXT, "sendto");
+    }
+    size = realSendto(fd, buffer, length, flags, address, addressLength);
+    NoteSent(fd, size, address, addressLength);
+    return size;
+}
+
+ssize_t send(int fd, const void *buffer, size_t length, int flags)
+{
+    static ssize_t (*realSend)(int, const void *, size_t, int);
+    ssize_t size;
+
+    if (realSend == NULL)
+    {
+        realSend = dlsym(RTLD_NEXT, "send");
+    }
+    size = realSend(fd, buffer, length, flags);
+    NoteSent(fd, size, NULL, 0);
+    return size;
+}
+
+ssize_t sendmsg(int fd, const struct msghdr *message, int flags)
+{
+    static ssize_t (*realSendmsg)(int, const struct msghdr *, int);
+    ssize_t size;
+
+    if (realSendmsg == NULL)
+    {
+        realSendmsg = dlsym(RTLD_NEXT, "sendmsg");
+    }
+    size = realSendmsg(fd, message, flags);
+    NoteSent(fd, size, message->msg_name, message->msg_namelen);
+    return size;
+}
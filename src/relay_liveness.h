@@ -0,0 +1,56 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_liveness.h
+ * @brief Device Server liveness taken from datagrams received by Awa client socket. Static client
+ *        doesn't report outcome of registration traffic, so socket calls made during
+ *        AwaStaticClient_Process are intercepted instead. Only datagrams from addresses the client
+ *        sent to count, on idle session these are responses to registration updates, sent by
+ *        client once per registration lifetime. Response code is not inspected (payload may be
+ *        DTLS encrypted), so error responses count as contact too.
+ */
+
+#ifndef RELAY_LIVENESS_H
+#define RELAY_LIVENESS_H
+
+/**
+ * @brief Starts feeding connection loss timer with datagrams received on given local UDP port.
+ * @param port local port of Awa client socket.
+ */
+void RelayLiveness_Watch(unsigned short port);
+
+/**
+ * @brief Returns Awa client socket, so main loop can wait for incoming requests on it.
+ * @return socket descriptor, -1 until client has used it or if it has been closed since.
+ */
+int RelayLiveness_GetSocket(void);
+
+#endif  /* RELAY_LIVENESS_H */
@@ -0,0 +1,345 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file  relay_replay.c
+ * @brief Replays handler trace recorded by relay_gateway_appd (-t option) through the same resource
+ *        handlers and GPIO backend, either with recorded pacing or as fast as possible, and reports
+ *        handler throughput and resulting relay state sequence.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "relay_control.h"
+#include "relay_accounting.h"
+#include "relay_trace.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Typedef
+ **************************************************************************************************/
+
+/**
+ * Trace record loaded in memory, so file access is not part of measured replay.
+ */
+typedef struct
+{
+    /*@{*/
+    RelayTraceRecord record; /**< recorded invocation */
+    uint64_t payload[RELAY_TRACE_MAX_PAYLOAD / sizeof(uint64_t)]; /**< recorded resource data */
+    /*@}*/
+} TraceEntry;
+
+/**
+ * Relay state change caused by replayed invocation.
+ */
+typedef struct
+{
+    /*@{*/
+    size_t index; /**< index of invocation in trace */
+    uint64_t offsetNs; /**< recorded time of invocation since start of trace */
+    uint16_t instanceID; /**< relay object instance ID */
+    bool state; /**< relay state after invocation */
+    /*@}*/
+} StateChange;
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Set default debug level to warning, relay state changes are reported in summary instead. */
+int g_debugLevel = LOG_WARN;
+/** Set default debug stream to NULL. */
+FILE * g_debugStream = NULL;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+/**
+ * @brief Prints relay_replay usage.
+ * @param *program holds application name.
+ */
+static void PrintUsage(const char *program)
+{
+    printf("Usage: %s [options] trace_file\n\n"
+        " -r : Replay with recorded pacing, default is as fast as possible.\n"
+        " -g : GPIO sysfs directory, mandatory. Pass " DEFAULT_GPIO_ROOT " only to drive real\n"
+        "      relay on purpose, otherwise use scratch directory containing gpio" RELAY_GPIO_PIN "/value.\n"
+        " -v : Debug level from 1 to 5\n"
+        "      fatal(1), error(2), warning(3), info(4), debug(5) and max(>5)\n"
+        "      default is warning.\n"
+        " -h : Print help and exit.\n\n",
+        program);
+}
+
+static uint64_t MonotonicNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until given CLOCK_MONOTONIC time.
+ */
+static void SleepUntil(uint64_t deadlineNs)
+{
+    struct timespec ts;
+    ts.tv_sec = deadlineNs / 1000000000ull;
+    ts.tv_nsec = deadlineNs % 1000000000ull;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0)
+    {
+    }
+}
+
+/**
+ * @brief Loads all records of trace file.
+ * @param *filePath trace file.
+ * @param **entries stores loaded records, to be freed by caller.
+ * @return number of loaded records, -1 on failure.
+ */
+static long LoadTrace(const char *filePath, TraceEntry **entries)
+{
+    FILE *traceFile = RelayTrace_Open(filePath);
+    TraceEntry *loaded = NULL, *tmp;
+    size_t count = 0, capacity = 0;
+
+    if (traceFile == NULL)
+    {
+        return -1;
+    }
+
+    while (1)
+    {
+        if (count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 1024;
+            tmp = realloc(loaded, capacity * sizeof(*loaded));
+            if (tmp == NULL)
+            {
+                LOG(LOG_ERR, "Not enough memory to load trace.");
+                free(loaded);
+                fclose(traceFile);
+                return -1;
+            }
+            loaded = tmp;
+        }
+        if (!RelayTrace_Next(traceFile, &loaded[count].record, (uint8_t *)loaded[count].payload))
+        {
+            break;
+        }
+        count++;
+    }
+
+    fclose(traceFile);
+    *entries = loaded;
+    return count;
+}
+
+/**
+ * @brief Returns handler which serves given resource in relay gateway.
+ */
+static AwaStaticClientHandler GetHandler(const RelayTraceRecord *record)
+{
+    if (record->objectID != RELAY_OBJECT_ID)
+    {
+        return NULL;
+    }
+    switch (record->resourceID)
+    {
+        case RELAY_RESOURCE_ID:
+            return RelayStateResourceHandler;
+
+        case ON_TIME_RESOURCE_ID:
+        case CYCLE_COUNTER_RESOURCE_ID:
+            return RelayAccountingResourceHandler;
+
+        default:
+            return NULL;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    TraceEntry *entries = NULL;
+    StateChange *changes = NULL;
+    size_t numChanges = 0, replayed = 0, skipped = 0, mismatched = 0, i;
+    uint64_t handlerNs = 0, startNs, elapsedNs, firstNs, callNs;
+    bool paced = false, lastState;
+    const char *gpioRoot = NULL;
+    long numEntries;
+    int opt, tmp;
+
+    while ((opt = getopt(argc, argv, "rg:v:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r':
+                paced = true;
+                break;
+
+            case 'g':
+                gpioRoot = optarg;
+                break;
+
+            case 'v':
+                tmp = strtoul(optarg, NULL, 0);
+                if (tmp >= LOG_FATAL && tmp <= LOG_DBG)
+                {
+                    g_debugLevel = tmp;
+                }
+                break;
+
+            case 'h':
+                PrintUsage(argv[0]);
+                return 0;
+
+            default:
+                PrintUsage(argv[0]);
+                return -1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    /* Replaying production trace on live sysfs would toggle real relay at full speed. */
+    if (gpioRoot == NULL)
+    {
+        LOG(LOG_ERR, "GPIO sysfs directory (-g) is mandatory.");
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    if (strcmp(gpioRoot, DEFAULT_GPIO_ROOT) == 0)
+    {
+        LOG(LOG_WARN, "Replaying on real GPIO, relay will be switched.");
+    }
+    RelayControl_SetGPIORoot(gpioRoot);
+
+    numEntries = LoadTrace(argv[optind], &entries);
+    if (numEntries <= 0)
+    {
+        LOG(LOG_ERR, "Nothing to replay.");
+        free(entries);
+        return -1;
+    }
+
+    changes = malloc(numEntries * sizeof(*changes));
+    if (changes == NULL)
+    {
+        LOG(LOG_ERR, "Not enough memory to replay trace.");
+        free(entries);
+        return -1;
+    }
+
+    /* Counters are never persisted by replay, so production counters are left untouched. */
+    RelayAccounting_Init(NULL, RELAY_ACCOUNTING_MAX_INSTANCES, 0);
+    if (ReadGPIO(&g_relayState, atoi(RELAY_GPIO_PIN)) != 0)
+    {
+        LOG(LOG_WARN, "Failed to read initial relay state, assuming off.");
+    }
+    lastState = g_relayState;
+
+    firstNs = entries[0].record.timestampNs;
+    startNs = MonotonicNs();
+    for (i = 0; i < (size_t)numEntries; i++)
+    {
+        RelayTraceRecord *record = &entries[i].record;
+        AwaStaticClientHandler handler = GetHandler(record);
+        void *data = record->operation == AwaOperation_Write ? entries[i].payload : NULL;
+        size_t dataSize = record->operation == AwaOperation_Write ? record->payloadSize : 0;
+        bool changed = false;
+        AwaResult result;
+
+        if (handler == NULL)
+        {
+            skipped++;
+            continue;
+        }
+        if (paced && MonotonicNs() < startNs + (record->timestampNs - firstNs))
+        {
+            SleepUntil(startNs + (record->timestampNs - firstNs));
+        }
+
+        callNs = MonotonicNs();
+        result = handler(NULL, record->operation, record->objectID, record->objectInstanceID,
+                         record->resourceID, record->resourceInstanceID, &data, &dataSize,
+                         &changed);
+        handlerNs += MonotonicNs() - callNs;
+        replayed++;
+
+        if (result != record->result)
+        {
+            mismatched++;
+            LOG(LOG_WARN, "Record %zu: /%u/%u/%u returned %d, recorded %d", i, record->objectID,
+                record->objectInstanceID, record->resourceID, result, record->result);
+        }
+        if (record->resourceID == RELAY_RESOURCE_ID && g_relayState != lastState)
+        {
+            lastState = g_relayState;
+            changes[numChanges].index = i;
+            changes[numChanges].offsetNs = record->timestampNs - firstNs;
+            changes[numChanges].instanceID = record->objectInstanceID;
+            changes[numChanges].state = g_relayState;
+            numChanges++;
+        }
+    }
+    elapsedNs = MonotonicNs() - startNs;
+
+    printf("Relay state sequence:\n");
+    for (i = 0; i < numChanges; i++)
+    {
+        printf("  #%zu +%.6fs /3201/%u/5550 = %d\n", changes[i].index,
+               changes[i].offsetNs / 1e9, changes[i].instanceID, changes[i].state);
+    }
+    printf("Records: %ld, replayed: %zu, skipped: %zu, result mismatches: %zu\n",
+           numEntries, replayed, skipped, mismatched);
+    printf("Replay time: %.6fs (%s), handler time: %.6fs\n", elapsedNs / 1e9,
+           paced ? "recorded pacing" : "max speed", handlerNs / 1e9);
+    if (replayed > 0 && handlerNs > 0)
+    {
+        printf("Handler throughput: %.0f ops/s, %.0f ns/op\n",
+               replayed * 1e9 / handlerNs, (double)handlerNs / replayed);
+    }
+
+    RelayAccounting_Deinit();
+    free(changes);
+    free(entries);
+    return mismatched == 0 ? 0 : 1;
+}
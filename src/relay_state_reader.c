@@ -0,0 +1,142 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_state_reader.c
+ * @brief Lock-free reader of relay state segment published by relay gateway.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "relay_state_reader.h"
+
+/***************************************************************************************************
+ * Typedef
+ **************************************************************************************************/
+
+/**
+ * Reader handle.
+ */
+struct RelayStateReader
+{
+    /*@{*/
+    const RelayStateShm *shm; /**< read only mapping of segment */
+    /*@}*/
+};
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+RelayStateReader *RelayStateReader_Open(const char *name)
+{
+    RelayStateReader *reader;
+    struct stat st;
+    void *mapping;
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    /* Gateway sizes segment after creating it, touching mapping of shorter object raises SIGBUS. */
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(RelayStateShm))
+    {
+        close(fd);
+        return NULL;
+    }
+    mapping = mmap(NULL, sizeof(RelayStateShm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    reader = malloc(sizeof(*reader));
+    if (reader == NULL)
+    {
+        munmap(mapping, sizeof(RelayStateShm));
+        return NULL;
+    }
+    reader->shm = mapping;
+    return reader;
+}
+
+bool RelayStateReader_Snapshot(const RelayStateReader *reader, RelayStateSnapshot *snapshot)
+{
+    const RelayStateShm *shm;
+    uint32_t sequence;
+
+    if (reader == NULL || snapshot == NULL)
+    {
+        return false;
+    }
+
+    shm = reader->shm;
+    do
+    {
+        if (!RelayStateShm_ReadBegin(shm, &sequence))
+        {
+            return false;
+        }
+        if (shm->magic != RELAY_STATE_SHM_MAGIC || shm->version != RELAY_STATE_SHM_VERSION)
+        {
+            return false;
+        }
+        snapshot->generation = shm->generation;
+        snapshot->publishedMonotonicNs = shm->publishedMonotonicNs;
+        snapshot->numInstances = shm->numInstances;
+        memcpy(snapshot->instances, shm->instances, sizeof(snapshot->instances));
+    } while (RelayStateShm_ReadRetry(shm, sequence));
+
+    if (snapshot->numInstances > RELAY_STATE_SHM_MAX_INSTANCES)
+    {
+        return false;
+    }
+    return true;
+}
+
+void RelayStateReader_Close(RelayStateReader *reader)
+{
+    if (reader == NULL)
+    {
+        return;
+    }
+    munmap((void *)reader->shm, sizeof(RelayStateShm));
+    free(reader);
+}
@@ -0,0 +1,81 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_state_reader.h
+ * @brief Reader library for relay state published by relay gateway in shared memory. Once segment
+ *        is opened, snapshots are taken without any system call and without blocking the gateway.
+ */
+
+#ifndef RELAY_STATE_READER_H
+#define RELAY_STATE_READER_H
+
+#include <stdbool.h>
+#include "relay_state_shm.h"
+
+/** Opaque handle of mapped relay state segment. */
+typedef struct RelayStateReader RelayStateReader;
+
+/**
+ * Consistent copy of relay state of all instances.
+ */
+typedef struct
+{
+    /*@{*/
+    uint64_t generation; /**< publish generation, changes whenever any instance changes */
+    uint64_t publishedMonotonicNs; /**< CLOCK_MONOTONIC time of last publish */
+    unsigned int numInstances; /**< number of valid entries in instances */
+    RelayStateShmInstance instances[RELAY_STATE_SHM_MAX_INSTANCES]; /**< per instance state */
+    /*@}*/
+} RelayStateSnapshot;
+
+/**
+ * @brief Maps relay state segment published by gateway.
+ * @param *name segment name, RELAY_STATE_SHM_NAME for gateway.
+ * @return reader handle, or NULL if gateway does not publish state or segment is still being
+ *         created.
+ */
+RelayStateReader *RelayStateReader_Open(const char *name);
+
+/**
+ * @brief Takes consistent snapshot of relay state.
+ * @param *reader handle returned by RelayStateReader_Open.
+ * @param *snapshot stores copied state.
+ * @return true on success, false if segment is not (or no longer) initialised or gateway got stuck
+ *         in the middle of update.
+ */
+bool RelayStateReader_Snapshot(const RelayStateReader *reader, RelayStateSnapshot *snapshot);
+
+/**
+ * @brief Unmaps relay state segment and frees reader.
+ */
+void RelayStateReader_Close(RelayStateReader *reader);
+
+#endif  /* RELAY_STATE_READER_H */
@@ -0,0 +1,165 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_state_shm.c
+ * @brief Publishes relay state into shared memory segment, so local processes can read it without
+ *        talking to Device Server or racing with gateway on GPIO sysfs.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "relay_state_shm.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Mapped shared memory segment, NULL when publishing is disabled. */
+static RelayStateShm *g_shm = NULL;
+/** Name of mapped segment, removed on destroy. */
+static char g_name[NAME_MAX];
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+/**
+ * @brief Reads given clock in nanoseconds.
+ */
+static uint64_t ClockNs(clockid_t clockID)
+{
+    struct timespec ts;
+    clock_gettime(clockID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool RelayStateShm_Create(const char *name, unsigned int numInstances)
+{
+    int fd;
+    void *mapping;
+
+    if (numInstances > RELAY_STATE_SHM_MAX_INSTANCES)
+    {
+        LOG(LOG_ERR, "Can't publish %u relay instances, shared memory holds at most %d",
+            numInstances, RELAY_STATE_SHM_MAX_INSTANCES);
+        return false;
+    }
+
+    fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd == -1)
+    {
+        LOG(LOG_ERR, "Failed to open shared memory %s", name);
+        return false;
+    }
+    if (ftruncate(fd, sizeof(RelayStateShm)) == -1)
+    {
+        LOG(LOG_ERR, "Failed to resize shared memory %s", name);
+        close(fd);
+        return false;
+    }
+    mapping = mmap(NULL, sizeof(RelayStateShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        LOG(LOG_ERR, "Failed to map shared memory %s", name);
+        return false;
+    }
+
+    g_shm = mapping;
+    strncpy(g_name, name, sizeof(g_name) - 1);
+    /* Sequence stays odd if previous gateway died during update, readers already fail snapshots. */
+    if ((g_shm->sequence & 1) == 0)
+    {
+        RelayStateShm_WriteBegin(g_shm);
+    }
+    memset(g_shm->instances, 0, sizeof(g_shm->instances));
+    g_shm->numInstances = numInstances;
+    g_shm->generation++;
+    g_shm->publishedMonotonicNs = ClockNs(CLOCK_MONOTONIC);
+    g_shm->version = RELAY_STATE_SHM_VERSION;
+    g_shm->magic = RELAY_STATE_SHM_MAGIC;
+    RelayStateShm_WriteEnd(g_shm);
+
+    LOG(LOG_INFO, "Publishing relay state in shared memory %s", name);
+    return true;
+}
+
+void RelayStateShm_Publish(unsigned int instanceID, bool state)
+{
+    RelayStateShmInstance *instance;
+
+    if (g_shm == NULL || instanceID >= g_shm->numInstances)
+    {
+        return;
+    }
+
+    instance = &g_shm->instances[instanceID];
+    if (instance->valid && instance->state == state)
+    {
+        return;
+    }
+
+    RelayStateShm_WriteBegin(g_shm);
+    instance->valid = 1;
+    instance->state = state;
+    instance->changeCount++;
+    instance->changedMonotonicNs = ClockNs(CLOCK_MONOTONIC);
+    instance->changedRealtimeNs = ClockNs(CLOCK_REALTIME);
+    g_shm->generation++;
+    g_shm->publishedMonotonicNs = instance->changedMonotonicNs;
+    RelayStateShm_WriteEnd(g_shm);
+}
+
+void RelayStateShm_Destroy(void)
+{
+    if (g_shm == NULL)
+    {
+        return;
+    }
+    RelayStateShm_WriteBegin(g_shm);
+    g_shm->magic = 0;
+    g_shm->generation++;
+    RelayStateShm_WriteEnd(g_shm);
+    munmap(g_shm, sizeof(RelayStateShm));
+    g_shm = NULL;
+    shm_unlink(g_name);
+}
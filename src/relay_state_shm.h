@@ -0,0 +1,144 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_state_shm.h
+ * @brief Layout of the shared memory segment in which relay gateway publishes relay state of all
+ *        instances, and the seqlock used to keep it consistent for lock-free local readers.
+ */
+
+#ifndef RELAY_STATE_SHM_H
+#define RELAY_STATE_SHM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! \{
+#define RELAY_STATE_SHM_NAME            "/relay_gateway_state"
+#define RELAY_STATE_SHM_MAGIC           (0x52475354u)   /* "RGST" */
+#define RELAY_STATE_SHM_VERSION         (1)
+#define RELAY_STATE_SHM_MAX_INSTANCES   (8)
+#define RELAY_STATE_SHM_MAX_SPINS       (1000000)
+//! \}
+
+/**
+ * State of single relay instance as seen by gateway.
+ */
+typedef struct
+{
+    /*@{*/
+    uint8_t valid; /**< non zero once instance state has been published */
+    uint8_t state; /**< current relay state, 0 - off, 1 - on */
+    uint16_t reserved; /**< padding, always 0 */
+    uint32_t changeCount; /**< number of state changes published for this instance */
+    uint64_t changedMonotonicNs; /**< CLOCK_MONOTONIC time of last state change */
+    uint64_t changedRealtimeNs; /**< CLOCK_REALTIME time of last state change */
+    /*@}*/
+} RelayStateShmInstance;
+
+/**
+ * Shared memory segment layout. Writer is the gateway only, any number of processes can read.
+ * Sequence is odd while writer updates the segment and readers must retry until they observe the
+ * same even sequence before and after copying data.
+ */
+typedef struct
+{
+    /*@{*/
+    uint32_t magic; /**< RELAY_STATE_SHM_MAGIC once segment is initialised */
+    uint32_t version; /**< RELAY_STATE_SHM_VERSION */
+    uint32_t sequence; /**< seqlock sequence counter */
+    uint32_t numInstances; /**< number of valid entries in instances */
+    uint64_t generation; /**< incremented on every publish */
+    uint64_t publishedMonotonicNs; /**< CLOCK_MONOTONIC time of last publish */
+    RelayStateShmInstance instances[RELAY_STATE_SHM_MAX_INSTANCES]; /**< per instance state */
+    /*@}*/
+} RelayStateShm;
+
+/** Marks start of seqlock protected update, sequence becomes odd. */
+static inline void RelayStateShm_WriteBegin(RelayStateShm *shm)
+{
+    __atomic_store_n(&shm->sequence, shm->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** Marks end of seqlock protected update, sequence becomes even. */
+static inline void RelayStateShm_WriteEnd(RelayStateShm *shm)
+{
+    __atomic_store_n(&shm->sequence, shm->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Waits for even sequence and stores it, to be passed to RelayStateShm_ReadRetry. Returns false if
+ * sequence stays odd for RELAY_STATE_SHM_MAX_SPINS reads, e.g. when writer died during update.
+ */
+static inline bool RelayStateShm_ReadBegin(const RelayStateShm *shm, uint32_t *sequence)
+{
+    unsigned int spins;
+    for (spins = 0; spins < RELAY_STATE_SHM_MAX_SPINS; spins++)
+    {
+        *sequence = __atomic_load_n(&shm->sequence, __ATOMIC_ACQUIRE);
+        if ((*sequence & 1) == 0)
+        {
+            return true;
+        }
+        __asm__ __volatile__("" ::: "memory");
+    }
+    return false;
+}
+
+/** Returns true if data copied since RelayStateShm_ReadBegin may be torn and must be read again. */
+static inline bool RelayStateShm_ReadRetry(const RelayStateShm *shm, uint32_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&shm->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+/**
+ * @brief Creates (or reuses) shared memory segment and maps it for writing.
+ * @param *name segment name, RELAY_STATE_SHM_NAME for gateway.
+ * @param numInstances number of relay instances that gateway will publish.
+ * @return true if segment is ready for publishing, false otherwise.
+ */
+bool RelayStateShm_Create(const char *name, unsigned int numInstances);
+
+/**
+ * @brief Publishes state of relay instance. Does nothing if segment was not created.
+ * @param instanceID relay object instance ID.
+ * @param state current relay state.
+ */
+void RelayStateShm_Publish(unsigned int instanceID, bool state);
+
+/**
+ * @brief Invalidates, unmaps and removes shared memory segment, so readers still holding it stop
+ *        getting snapshots.
+ */
+void RelayStateShm_Destroy(void);
+
+#endif  /* RELAY_STATE_SHM_H */
@@ -0,0 +1,169 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_trace.c
+ * @brief Records resource handler invocations to binary trace and reads them back for replay.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "relay_trace.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Trace being recorded, NULL when recording is off. */
+static FILE *g_traceFile = NULL;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+bool RelayTrace_Start(const char *filePath)
+{
+    RelayTraceHeader header = { RELAY_TRACE_MAGIC, RELAY_TRACE_VERSION };
+
+    g_traceFile = fopen(filePath, "wb");
+    if (g_traceFile == NULL)
+    {
+        LOG(LOG_ERR, "Failed to create trace file %s", filePath);
+        return false;
+    }
+    if (fwrite(&header, sizeof(header), 1, g_traceFile) != 1)
+    {
+        LOG(LOG_ERR, "Failed to write trace file %s", filePath);
+        RelayTrace_Stop();
+        return false;
+    }
+    LOG(LOG_INFO, "Recording handler trace to %s", filePath);
+    return true;
+}
+
+void RelayTrace_Record(AwaOperation operation,
+                       AwaObjectID objectID,
+                       AwaObjectInstanceID objectInstanceID,
+                       AwaResourceID resourceID,
+                       AwaResourceInstanceID resourceInstanceID,
+                       const void *payload,
+                       size_t payloadSize,
+                       AwaResult result)
+{
+    RelayTraceRecord record;
+    struct timespec ts;
+
+    if (g_traceFile == NULL)
+    {
+        return;
+    }
+
+    if (payload == NULL)
+    {
+        payloadSize = 0;
+    }
+    else if (payloadSize > RELAY_TRACE_MAX_PAYLOAD)
+    {
+        payloadSize = RELAY_TRACE_MAX_PAYLOAD;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    memset(&record, 0, sizeof(record));
+    record.timestampNs = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    record.objectID = objectID;
+    record.objectInstanceID = objectInstanceID;
+    record.resourceID = resourceID;
+    record.resourceInstanceID = resourceInstanceID;
+    record.operation = operation;
+    record.result = result;
+    record.payloadSize = payloadSize;
+
+    /* Flush every record, trace is meant to catch misbehaviour which may end with crash. */
+    if (fwrite(&record, sizeof(record), 1, g_traceFile) != 1 ||
+        (payloadSize > 0 && fwrite(payload, payloadSize, 1, g_traceFile) != 1) ||
+        fflush(g_traceFile) != 0)
+    {
+        LOG(LOG_ERR, "Failed to write trace record, recording stopped.");
+        RelayTrace_Stop();
+    }
+}
+
+void RelayTrace_Stop(void)
+{
+    if (g_traceFile != NULL)
+    {
+        fclose(g_traceFile);
+        g_traceFile = NULL;
+    }
+}
+
+FILE *RelayTrace_Open(const char *filePath)
+{
+    RelayTraceHeader header;
+    FILE *traceFile = fopen(filePath, "rb");
+
+    if (traceFile == NULL)
+    {
+        LOG(LOG_ERR, "Failed to open trace file %s", filePath);
+        return NULL;
+    }
+    if (fread(&header, sizeof(header), 1, traceFile) != 1 ||
+        header.magic != RELAY_TRACE_MAGIC || header.version != RELAY_TRACE_VERSION)
+    {
+        LOG(LOG_ERR, "%s is not a relay gateway trace file", filePath);
+        fclose(traceFile);
+        return NULL;
+    }
+    return traceFile;
+}
+
+bool RelayTrace_Next(FILE *traceFile, RelayTraceRecord *record, uint8_t *payload)
+{
+    if (fread(record, sizeof(*record), 1, traceFile) != 1)
+    {
+        return false;
+    }
+    if (record->payloadSize > RELAY_TRACE_MAX_PAYLOAD)
+    {
+        LOG(LOG_ERR, "Malformed trace record");
+        return false;
+    }
+    if (record->payloadSize > 0 && fread(payload, record->payloadSize, 1, traceFile) != 1)
+    {
+        LOG(LOG_ERR, "Truncated trace record");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_trace.h
+ * @brief Compact binary trace of resource handler invocations. Trace file starts with
+ *        RelayTraceHeader followed by records, each being RelayTraceRecord and payloadSize bytes of
+ *        resource data (written data for write, returned data for successful read).
+ */
+
+#ifndef RELAY_TRACE_H
+#define RELAY_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "awa/static.h"
+
+//! \{
+#define RELAY_TRACE_MAGIC           (0x52475452u)   /* "RGTR" */
+#define RELAY_TRACE_VERSION         (2)
+#define RELAY_TRACE_MAX_PAYLOAD     (64)
+//! \}
+
+/**
+ * Trace file header.
+ */
+typedef struct
+{
+    /*@{*/
+    uint32_t magic; /**< RELAY_TRACE_MAGIC */
+    uint32_t version; /**< RELAY_TRACE_VERSION */
+    /*@}*/
+} RelayTraceHeader;
+
+/**
+ * Single handler invocation.
+ */
+typedef struct
+{
+    /*@{*/
+    uint64_t timestampNs; /**< CLOCK_MONOTONIC time of invocation */
+    uint16_t objectID; /**< object ID */
+    uint16_t objectInstanceID; /**< object instance ID */
+    uint16_t resourceID; /**< resource ID */
+    uint16_t resourceInstanceID; /**< resource instance ID */
+    uint8_t operation; /**< AwaOperation */
+    uint8_t reserved; /**< padding, always 0 */
+    uint16_t result; /**< AwaResult returned by handler */
+    uint16_t payloadSize; /**< number of payload bytes following record */
+    uint16_t reserved2; /**< padding, always 0 */
+    /*@}*/
+} RelayTraceRecord;
+
+/**
+ * @brief Starts recording handler invocations to file, truncating it.
+ * @param *filePath trace file.
+ * @return true if recording started, false otherwise.
+ */
+bool RelayTrace_Start(const char *filePath);
+
+/**
+ * @brief Appends handler invocation to trace. Does nothing when recording is not started.
+ * @param *payload resource data, may be NULL.
+ * @param payloadSize size of resource data, truncated to RELAY_TRACE_MAX_PAYLOAD.
+ */
+void RelayTrace_Record(AwaOperation operation,
+                       AwaObjectID objectID,
+                       AwaObjectInstanceID objectInstanceID,
+                       AwaResourceID resourceID,
+                       AwaResourceInstanceID resourceInstanceID,
+                       const void *payload,
+                       size_t payloadSize,
+                       AwaResult result);
+
+/**
+ * @brief Stops recording and closes trace file.
+ */
+void RelayTrace_Stop(void);
+
+/**
+ * @brief Opens trace file for reading and validates its header.
+ * @return trace file positioned at first record, or NULL on failure.
+ */
+FILE *RelayTrace_Open(const char *filePath);
+
+/**
+ * @brief Reads next record of trace.
+ * @param *traceFile trace file returned by RelayTrace_Open.
+ * @param *record stores record.
+ * @param *payload stores at least RELAY_TRACE_MAX_PAYLOAD bytes of payload.
+ * @return true if record was read, false at end of trace or on malformed record.
+ */
+bool RelayTrace_Next(FILE *traceFile, RelayTraceRecord *record, uint8_t *payload);
+
+#endif  /* RELAY_TRACE_H */
@@ -0,0 +1,339 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_failsafe_test.c
+ * @brief Connection loss failover test. Client socket registers with local stand-in Device Server,
+ *        which then periodically sends datagrams (as registration update responses) to it, drained
+ *        by processing thread through intercepted receive path. Another host keeps sending to client
+ *        all the time and must not count as contact. Test pauses the server and checks that relay
+ *        reaches safe state within timeout plus tolerance, then resumes it and checks that commanded
+ *        state is re-asserted.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include "relay_control.h"
+#include "relay_accounting.h"
+#include "relay_failsafe.h"
+#include "relay_liveness.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define TIMEOUT_MS                  (300)
+#define TOLERANCE_MS                (50)
+#define UPDATE_PERIOD_MS            (50)
+#define RECEIVE_TIMEOUT_MS          (5)
+#define GPIO_POLL_US                (1000)
+#define PATH_SIZE                   (128)
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition))                                                                     \
+        {                                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);              \
+            return 1;                                                                         \
+        }                                                                                     \
+    } while (0)
+//! @endcond
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Set debug level to error, test reports its own failures. */
+int g_debugLevel = LOG_ERR;
+/** Set default debug stream to NULL. */
+FILE * g_debugStream = NULL;
+/** Stand-in server socket. */
+static int g_serverSocket = -1;
+/** Socket of unrelated host, never registered with. */
+static int g_otherSocket = -1;
+/** Client socket, stands for Awa client socket. */
+static int g_clientSocket = -1;
+/** Address of client socket. */
+static struct sockaddr_in g_clientAddress;
+/** Address of stand-in server socket. */
+static struct sockaddr_in g_serverAddress;
+/** Set while stand-in server does not respond. */
+static volatile int g_serverPaused = 0;
+/** Set to stop server and processing threads. */
+static volatile int g_stop = 0;
+/** CLOCK_MONOTONIC time of last datagram client received from server. */
+static volatile uint64_t g_lastReceiveMs = 0;
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+static uint64_t NowMs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Stand-in Device Server, answers registration updates every UPDATE_PERIOD_MS unless paused.
+ *        Unrelated host sends at the same rate regardless.
+ */
+static void *Server(void *context)
+{
+    const char response[] = "update response";
+
+    while (!g_stop)
+    {
+        if (!g_serverPaused)
+        {
+            sendto(g_serverSocket, response, sizeof(response), 0,
+                   (struct sockaddr *)&g_clientAddress, sizeof(g_clientAddress));
+        }
+        sendto(g_otherSocket, response, sizeof(response), 0,
+               (struct sockaddr *)&g_clientAddress, sizeof(g_clientAddress));
+        usleep(UPDATE_PERIOD_MS * 1000);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Stands for AwaStaticClient_Process, drains client socket through intercepted recvfrom.
+ */
+static void *Processing(void *context)
+{
+    struct sockaddr_in sender;
+    socklen_t length;
+    char buffer[64];
+
+    while (!g_stop)
+    {
+        length = sizeof(sender);
+        if (recvfrom(g_clientSocket, buffer, sizeof(buffer), 0, (struct sockaddr *)&sender,
+                     &length) > 0 && sender.sin_port == g_serverAddress.sin_port)
+        {
+            g_lastReceiveMs = NowMs();
+        }
+    }
+    return NULL;
+}
+
+static int OpenSocket(struct sockaddr_in *address)
+{
+    socklen_t length = sizeof(*address);
+    struct timeval timeout = { 0, RECEIVE_TIMEOUT_MS * 1000 };
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    memset(address, 0, sizeof(*address));
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd == -1 ||
+        bind(fd, (struct sockaddr *)address, sizeof(*address)) != 0 ||
+        getsockname(fd, (struct sockaddr *)address, &length) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+    {
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Creates scratch GPIO sysfs directory with relay pin exported.
+ */
+static bool CreateGPIORoot(char *root)
+{
+    char path[PATH_SIZE];
+    FILE *file;
+
+    if (mkdtemp(root) == NULL)
+    {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/gpio%s", root, RELAY_GPIO_PIN);
+    if (mkdir(path, 0755) != 0)
+    {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/gpio%s/direction", root, RELAY_GPIO_PIN);
+    if ((file = fopen(path, "w")) == NULL || fputs("in", file) == EOF || fclose(file) != 0)
+    {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s/gpio%s/value", root, RELAY_GPIO_PIN);
+    return (file = fopen(path, "w")) != NULL && fputs("0", file) != EOF && fclose(file) == 0;
+}
+
+/**
+ * @brief Removes scratch GPIO sysfs directory.
+ */
+static void RemoveGPIORoot(const char *root)
+{
+    char path[PATH_SIZE];
+
+    snprintf(path, sizeof(path), "%s/gpio%s/direction", root, RELAY_GPIO_PIN);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/gpio%s/value", root, RELAY_GPIO_PIN);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/gpio%s", root, RELAY_GPIO_PIN);
+    rmdir(path);
+    rmdir(root);
+}
+
+/**
+ * @brief Waits until relay output reaches state.
+ * @return CLOCK_MONOTONIC time when state was observed, 0 if not reached within timeoutMs.
+ */
+static uint64_t WaitForOutput(bool state, unsigned int timeoutMs)
+{
+    uint64_t deadline = NowMs() + timeoutMs;
+    bool value;
+
+    while (NowMs() < deadline)
+    {
+        if (ReadGPIO(&value, atoi(RELAY_GPIO_PIN)) == 0 && value == state)
+        {
+            return NowMs();
+        }
+        usleep(GPIO_POLL_US);
+    }
+    return 0;
+}
+
+static int TestFailover(void)
+{
+    const bool safeStates[1] = { false };
+    const char request[] = "register";
+    uint64_t pausedMs, safeMs, resumedMs, restoredMs, latency;
+    bool value;
+
+    /* Commanded state is on, safe state is off. */
+    g_relayState = true;
+    RelayControl_ReassertState(0);
+    CHECK(ReadGPIO(&value, atoi(RELAY_GPIO_PIN)) == 0 && value);
+
+    CHECK(RelayFailsafe_Start(1, safeStates, TIMEOUT_MS));
+    RelayLiveness_Watch(ntohs(g_clientAddress.sin_port));
+
+    /* Until client sends to server, nothing it receives counts and relay keeps commanded state. */
+    usleep(3 * TIMEOUT_MS * 1000);
+    CHECK(!RelayFailsafe_IsActive());
+    /* Client socket is found from receive calls alone, so idle main loop can wait on it. */
+    CHECK(RelayLiveness_GetSocket() == g_clientSocket);
+    CHECK(sendto(g_clientSocket, request, sizeof(request), 0,
+                 (struct sockaddr *)&g_serverAddress, sizeof(g_serverAddress)) > 0);
+
+    /* Healthy session never trips, however long it stays idle. */
+    usleep(3 * TIMEOUT_MS * 1000);
+    CHECK(!RelayFailsafe_IsActive());
+    CHECK(ReadGPIO(&value, atoi(RELAY_GPIO_PIN)) == 0 && value);
+
+    g_serverPaused = 1;
+    pausedMs = NowMs();
+    safeMs = WaitForOutput(false, 2 * TIMEOUT_MS + TOLERANCE_MS);
+    CHECK(safeMs != 0);
+    latency = safeMs - g_lastReceiveMs;
+    printf("Safe state %llu ms after last contact (paused at +%llu ms), timeout %d ms\n",
+           (unsigned long long)latency, (unsigned long long)(pausedMs - g_lastReceiveMs),
+           TIMEOUT_MS);
+    CHECK(latency + 1 >= TIMEOUT_MS);
+    CHECK(latency <= TIMEOUT_MS + TOLERANCE_MS);
+    CHECK(RelayFailsafe_IsActive());
+
+    g_serverPaused = 0;
+    resumedMs = NowMs();
+    restoredMs = WaitForOutput(true, UPDATE_PERIOD_MS + TOLERANCE_MS);
+    CHECK(restoredMs != 0);
+    printf("Commanded state re-asserted %llu ms after resume\n",
+           (unsigned long long)(restoredMs - resumedMs));
+    CHECK(!RelayFailsafe_IsActive());
+
+    RelayFailsafe_Stop();
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    char gpioRoot[] = "/tmp/relay_failsafe_test.XXXXXX";
+    struct sockaddr_in otherAddress;
+    pthread_t server, processing;
+    int result;
+
+    if (!CreateGPIORoot(gpioRoot))
+    {
+        printf("Failed to create scratch GPIO directory\n");
+        return 1;
+    }
+    RelayControl_SetGPIORoot(gpioRoot);
+    RelayAccounting_Init(NULL, 1, 0);
+
+    g_clientSocket = OpenSocket(&g_clientAddress);
+    g_serverSocket = OpenSocket(&g_serverAddress);
+    g_otherSocket = OpenSocket(&otherAddress);
+    if (g_clientSocket == -1 || g_serverSocket == -1 || g_otherSocket == -1 ||
+        pthread_create(&server, NULL, Server, NULL) != 0 ||
+        pthread_create(&processing, NULL, Processing, NULL) != 0)
+    {
+        printf("Failed to start stand-in server\n");
+        RemoveGPIORoot(gpioRoot);
+        return 1;
+    }
+
+    result = TestFailover();
+
+    g_stop = 1;
+    pthread_join(server, NULL);
+    pthread_join(processing, NULL);
+    close(g_clientSocket);
+    close(g_serverSocket);
+    close(g_otherSocket);
+    RelayFailsafe_Stop();
+    RelayAccounting_Deinit();
+    RemoveGPIORoot(gpioRoot);
+
+    if (result == 0)
+    {
+        printf("All relay failsafe tests passed\n");
+    }
+    return result;
+}
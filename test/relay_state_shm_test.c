@@ -0,0 +1,274 @@
+/***************************************************************************************************
+ * Copyright (c) 2016, Imagination Technologies Limited and/or its affiliated group companies
+ * and/or licensors
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted
+ * provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions
+ *    and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of
+ *    conditions and the following disclaimer in the documentation and/or other materials provided
+ *    with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to
+ *    endorse or promote products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ * WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file relay_state_shm_test.c
+ * @brief Concurrency test of relay state shared memory. Writer thread publishes as fast as it can
+ *        while reader threads check that no snapshot is ever torn.
+ */
+
+/***************************************************************************************************
+ * Includes
+ **************************************************************************************************/
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "relay_state_shm.h"
+#include "relay_state_reader.h"
+#include "log.h"
+
+/***************************************************************************************************
+ * Definitions
+ **************************************************************************************************/
+
+//! @cond Doxygen_Suppress
+#define NUM_INSTANCES               (2)
+#define NUM_READERS                 (2)
+#define NUM_PUBLISHES               (1000000)
+
+#define CHECK(condition)                                                                      \
+    do {                                                                                      \
+        if (!(condition))                                                                     \
+        {                                                                                     \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);              \
+            return 1;                                                                         \
+        }                                                                                     \
+    } while (0)
+//! @endcond
+
+/***************************************************************************************************
+ * Typedef
+ **************************************************************************************************/
+
+/**
+ * Result of single reader thread.
+ */
+typedef struct
+{
+    /*@{*/
+    unsigned long snapshots; /**< number of snapshots taken */
+    unsigned long torn; /**< number of inconsistent snapshots */
+    /*@}*/
+} ReaderResult;
+
+/***************************************************************************************************
+ * Globals
+ **************************************************************************************************/
+
+/** Set debug level to error, test reports its own failures. */
+int g_debugLevel = LOG_ERR;
+/** Set default debug stream to NULL. */
+FILE * g_debugStream = NULL;
+/** Set once writer finished publishing. */
+static volatile int g_writerDone = 0;
+/** Name of test segment. */
+static char g_name[NAME_MAX];
+
+/***************************************************************************************************
+ * Implementation
+ **************************************************************************************************/
+
+static void *Writer(void *context)
+{
+    bool states[NUM_INSTANCES] = { false };
+    unsigned int i;
+
+    for (i = 0; i < NUM_PUBLISHES; i++)
+    {
+        states[i % NUM_INSTANCES] = !states[i % NUM_INSTANCES];
+        RelayStateShm_Publish(i % NUM_INSTANCES, states[i % NUM_INSTANCES]);
+    }
+    __atomic_store_n(&g_writerDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief Checks invariants kept by writer: every publish changes state of one instance, so its
+ *        state follows parity of its change count and generation advances with the sum of change
+ *        counts; last publish time is time of latest instance change.
+ */
+static bool IsConsistent(const RelayStateSnapshot *snapshot, uint64_t *base)
+{
+    uint64_t changes = 0, latest = 0;
+    unsigned int i;
+
+    if (snapshot->numInstances != NUM_INSTANCES)
+    {
+        return false;
+    }
+    for (i = 0; i < NUM_INSTANCES; i++)
+    {
+        const RelayStateShmInstance *instance = &snapshot->instances[i];
+        if (instance->state != (instance->changeCount & 1) ||
+            instance->valid != (instance->changeCount > 0))
+        {
+            return false;
+        }
+        changes += instance->changeCount;
+        if (instance->changedMonotonicNs > latest)
+        {
+            latest = instance->changedMonotonicNs;
+        }
+    }
+    if (*base == UINT64_MAX)
+    {
+        *base = snapshot->generation - changes;
+    }
+    return snapshot->generation - changes == *base &&
+           (changes == 0 || snapshot->publishedMonotonicNs == latest);
+}
+
+static void *Reader(void *context)
+{
+    ReaderResult *result = context;
+    RelayStateReader *reader = RelayStateReader_Open(g_name);
+    RelayStateSnapshot snapshot;
+    uint64_t base = UINT64_MAX, lastGeneration = 0;
+
+    if (reader == NULL)
+    {
+        result->torn++;
+        return NULL;
+    }
+    while (!__atomic_load_n(&g_writerDone, __ATOMIC_ACQUIRE))
+    {
+        if (!RelayStateReader_Snapshot(reader, &snapshot))
+        {
+            continue;
+        }
+        result->snapshots++;
+        if (!IsConsistent(&snapshot, &base) || snapshot.generation < lastGeneration)
+        {
+            result->torn++;
+        }
+        lastGeneration = snapshot.generation;
+    }
+    RelayStateReader_Close(reader);
+    return NULL;
+}
+
+static int TestConcurrentSnapshots(void)
+{
+    pthread_t writer, readers[NUM_READERS];
+    ReaderResult results[NUM_READERS] = { { 0, 0 } };
+    unsigned int i;
+
+    for (i = 0; i < NUM_READERS; i++)
+    {
+        CHECK(pthread_create(&readers[i], NULL, Reader, &results[i]) == 0);
+    }
+    CHECK(pthread_create(&writer, NULL, Writer, NULL) == 0);
+    pthread_join(writer, NULL);
+    for (i = 0; i < NUM_READERS; i++)
+    {
+        pthread_join(readers[i], NULL);
+        printf("Reader %u: %lu snapshots, %lu torn\n", i, results[i].snapshots, results[i].torn);
+        CHECK(results[i].snapshots > 0);
+        CHECK(results[i].torn == 0);
+    }
+    return 0;
+}
+
+static int TestStuckWriter(void)
+{
+    RelayStateReader *reader = RelayStateReader_Open(g_name);
+    RelayStateSnapshot snapshot;
+    RelayStateShm *shm;
+    int fd;
+
+    CHECK(reader != NULL);
+    fd = shm_open(g_name, O_RDWR, 0);
+    CHECK(fd != -1);
+    shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    CHECK(shm != MAP_FAILED);
+
+    /* Writer killed in the middle of update leaves sequence odd. */
+    RelayStateShm_WriteBegin(shm);
+    CHECK(!RelayStateReader_Snapshot(reader, &snapshot));
+    RelayStateShm_WriteEnd(shm);
+    CHECK(RelayStateReader_Snapshot(reader, &snapshot));
+
+    munmap(shm, sizeof(*shm));
+    RelayStateReader_Close(reader);
+    return 0;
+}
+
+static int TestUnsizedSegment(void)
+{
+    char name[NAME_MAX];
+    int fd;
+
+    /* Reader opening segment between gateway's shm_open and ftruncate must not map it. */
+    snprintf(name, sizeof(name), "%s.unsized", g_name);
+    fd = shm_open(name, O_CREAT | O_RDWR, 0600);
+    CHECK(fd != -1);
+    close(fd);
+    CHECK(RelayStateReader_Open(name) == NULL);
+    shm_unlink(name);
+    return 0;
+}
+
+static int TestDestroy(void)
+{
+    RelayStateReader *reader = RelayStateReader_Open(g_name);
+    RelayStateSnapshot snapshot;
+
+    CHECK(reader != NULL);
+    CHECK(RelayStateReader_Snapshot(reader, &snapshot));
+    RelayStateShm_Destroy();
+    CHECK(!RelayStateReader_Snapshot(reader, &snapshot));
+    CHECK(RelayStateReader_Open(g_name) == NULL);
+    RelayStateReader_Close(reader);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    /* Own segment, so test never touches state published by gateway running on the same device. */
+    snprintf(g_name, sizeof(g_name), "/relay_state_shm_test.%d", (int)getpid());
+    if (!RelayStateShm_Create(g_name, NUM_INSTANCES))
+    {
+        printf("Failed to create shared memory\n");
+        return 1;
+    }
+    if (TestConcurrentSnapshots() != 0 || TestStuckWriter() != 0 ||
+        TestUnsizedSegment() != 0 || TestDestroy() != 0)
+    {
+        RelayStateShm_Destroy();
+        return 1;
+    }
+    printf("All relay state shared memory tests passed\n");
+    return 0;
+}